@@ -0,0 +1,809 @@
+#include "sgl2.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+using namespace sgl2;
+
+// Benchmark suite for the SGL2 primitives and object windows.  Every case
+// runs on an offscreen window, so no display or GPU is needed, and the
+// results are printed as CSV (the default) or JSON:
+//
+//     bench [--format=csv|json] [--filter=<substring>]
+//
+// Each result reports the total time of a case, the time per operation
+// and the throughput, so runs of different library versions can be
+// compared line by line.
+
+static const int kWidth = 800;
+static const int kHeight = 600;
+
+// Benchmarks store their results here so the work is not optimized away
+static volatile long bench_sink;
+
+struct BenchResult {
+	string name;
+	long param;
+	long ops;
+	double seconds;
+};
+
+class BenchReporter {
+private:
+	vector<BenchResult> results_;
+	string filter_;
+
+public:
+	explicit BenchReporter(const string& filter) : filter_(filter) {}
+
+	bool Enabled(const string& name) const {
+		return filter_.empty() || name.find(filter_) != string::npos;
+	}
+
+	// Times ops operations performed by func, if name passes the filter
+	template <typename Func>
+	void Measure(const string& name, long param, long ops, Func func) {
+		if (!Enabled(name))
+			return;
+		Uint64 start = SDL_GetPerformanceCounter();
+		func();
+		Uint64 elapsed = SDL_GetPerformanceCounter() - start;
+		results_.push_back(BenchResult{ name, param, ops,
+			(double)elapsed / SDL_GetPerformanceFrequency() });
+	}
+
+	void PrintCsv() const {
+		printf("case,param,ops,total_us,us_per_op,ops_per_sec\n");
+		for (const BenchResult& r : results_)
+			printf("%s,%ld,%ld,%.3f,%.6f,%.1f\n", r.name.c_str(), r.param, r.ops,
+				r.seconds * 1e6, r.seconds * 1e6 / r.ops, r.ops / r.seconds);
+	}
+
+	void PrintJson() const {
+		printf("[\n");
+		for (size_t i = 0; i < results_.size(); i++) {
+			const BenchResult& r = results_[i];
+			printf("  {\"case\": \"%s\", \"param\": %ld, \"ops\": %ld, \"total_us\": %.3f, "
+				"\"us_per_op\": %.6f, \"ops_per_sec\": %.1f}%s\n", r.name.c_str(), r.param,
+				r.ops, r.seconds * 1e6, r.seconds * 1e6 / r.ops, r.ops / r.seconds,
+				i + 1 < results_.size() ? "," : "");
+		}
+		printf("]\n");
+	}
+};
+
+class BenchWindow : public Window {
+public:
+	BenchWindow()
+		: Window("bench", kWidth, kHeight, Color(0, 0, 0), WindowMode::kOffscreen) {}
+
+	void Paint() override {}
+
+	// The original per-pixel filled circle, kept here as the baseline
+	// the span rasterizer is measured against.
+	void DrawFilledCirclePerPixel(Color color, int x, int y, int radius) {
+		SetDrawColor(color);
+		for (int edge_y = -radius; edge_y <= radius; edge_y++)
+			for (int edge_x = -radius; edge_x <= radius; edge_x++)
+				if (edge_x*edge_x + edge_y*edge_y <= radius*radius)
+					SDL_RenderDrawPoint(renderer_, x + edge_x, y + edge_y);
+	}
+
+	// The original outline path: one SDL_RenderDrawPoint per rim pixel.
+	void DrawCirclePerPoint(Color color, int x, int y, int radius) {
+		SetDrawColor(color);
+		int current_x = 0, current_y = radius, s = 3 - 2 * radius;
+		while (current_x <= current_y) {
+			const SDL_Point octs[] = {
+				{ current_x, current_y }, { -current_x, current_y },
+				{ current_x, -current_y }, { -current_x, -current_y },
+				{ current_y, current_x }, { -current_y, current_x },
+				{ current_y, -current_x }, { -current_y, -current_x } };
+			for (const SDL_Point& p : octs)
+				SDL_RenderDrawPoint(renderer_, x + p.x, y + p.y);
+			if (s <= 0)
+				s = s + 4 * current_x + 6;
+			else {
+				s = s + 4 * (current_x - current_y) + 10;
+				current_y--;
+			}
+			current_x++;
+		}
+	}
+
+	// The naive text path: lays the string out on every call and plots
+	// each covered font pixel with its own SDL_RenderDrawPoint.
+	void DrawStringPerPoint(Color color, int x, int y, const string& text) {
+		SetDrawColor(color);
+		vector<GlyphQuad> glyphs;
+		font_->Layout(text, 1, glyphs);
+		const Uint8* coverage = font_->GetCoverage();
+		for (const GlyphQuad& glyph : glyphs)
+			for (int row = 0; row < glyph.source.h; row++)
+				for (int column = 0; column < glyph.source.w; column++)
+					if (coverage[(glyph.source.y + row) * font_->GetWidth() + glyph.source.x + column])
+						SDL_RenderDrawPoint(renderer_, x + glyph.dest.x + column,
+							y + glyph.dest.y + row);
+	}
+
+	// Uploads the software framebuffer too, when that backend is active
+	void Present() { PostPaint(); }
+};
+
+// Exposes the object list so the hit-testing cases can time the linear
+// scans that the spatial index replaced.
+class BenchObjectWindow : public ObjectWindow {
+public:
+	BenchObjectWindow()
+		: ObjectWindow("bench", kWidth, kHeight, Color(0, 0, 0), WindowMode::kOffscreen) {}
+
+	using ObjectWindow::StepBodies;
+
+	GraphicalObject* GetFirstHitLinear(int x, int y) {
+		for (GraphicalObject* o : objects_)
+			if (o && o->Hit(x, y))
+				return o;
+		return nullptr;
+	}
+
+	long CountCollisionPairsLinear() {
+		long pairs = 0;
+		for (size_t i = 0; i < objects_.size(); i++) {
+			if (!objects_[i])
+				continue;
+			for (size_t j = i + 1; j < objects_.size(); j++)
+				if (objects_[j] && objects_[i]->Collision(objects_[j]))
+					pairs++;
+		}
+		return pairs;
+	}
+};
+
+// The paddle of test.cpp: every MouseMoved hit-tests the pointer and
+// moves the paddle, which damages and repaints it.
+class BenchPaddleWindow : public ObjectWindow {
+private:
+	Rectangle* paddle_;
+
+public:
+	BenchPaddleWindow()
+		: ObjectWindow("bench", kWidth, kHeight, Color(0, 0, 0), WindowMode::kOffscreen) {
+		SetDamageTracking(true);
+		paddle_ = Get(Create<Rectangle>(Color(255, 255, 255), 0, 500, 150, 20, true));
+	}
+
+	void MouseMoved(const MouseMotionEvent& event) override {
+		bench_sink = bench_sink + (GetFirstHit(event.x, event.y) != nullptr);
+		paddle_->SetPosX(event.x - paddle_->GetWidth() / 2);
+	}
+
+	// The frame as it was before coalescing: a MouseMoved per event
+	void StepPerEvent() {
+		SDL_Event event;
+		while (SDL_PollEvent(&event))
+			DispatchEvent(event);
+		if (invalid_)
+			PaintAll();
+	}
+
+	void PushMotion(int x) {
+		SDL_Event event;
+		memset(&event, 0, sizeof(event));
+		event.type = SDL_MOUSEMOTION;
+		event.motion.x = x;
+		event.motion.y = 510;
+		event.motion.xrel = 1;
+		SDL_PushEvent(&event);
+	}
+};
+
+// Owns the objects of a benchmark scene.
+struct Scene {
+	vector<std::unique_ptr<Point>> points;
+	vector<std::unique_ptr<Rectangle>> rectangles;
+	vector<std::unique_ptr<Circle>> circles;
+	vector<GraphicalObject*> all;
+
+	// Adds count shapes, a mix of points, rectangles and circles in a few
+	// colors, scattered over a square world of side world.
+	void Populate(ObjectWindow& window, int count, int world, int max_size) {
+		const Color palette[] = { Color(255, 0, 0), Color(0, 255, 0),
+			Color(0, 0, 255), Color(255, 255, 255) };
+		for (int i = 0; i < count; i++) {
+			Color color = palette[rand() % 4];
+			int x = rand() % world, y = rand() % world;
+			int size = 2 + rand() % max_size;
+			GraphicalObject* obj;
+			switch (i % 4) {
+			case 0:
+				points.emplace_back(new Point(&window, color, x, y));
+				obj = points.back().get();
+				break;
+			case 1:
+				circles.emplace_back(new Circle(&window, color, x, y, size / 2, i % 8 == 1));
+				obj = circles.back().get();
+				break;
+			default:
+				rectangles.emplace_back(new Rectangle(&window, color, x, y, size, size, i % 3 == 0));
+				obj = rectangles.back().get();
+				break;
+			}
+			all.push_back(obj);
+			window.Add(obj);
+		}
+	}
+
+	void Clear(ObjectWindow& window) {
+		for (GraphicalObject* o : all)
+			window.Remove(o);
+		all.clear();
+		points.clear();
+		rectangles.clear();
+		circles.clear();
+	}
+};
+
+static const int kShapesPerFrame = 64;
+static const int kFrames = 20;
+
+static void BenchPrimitives(BenchReporter& reporter) {
+	BenchWindow window;
+	Color color(255, 100, 0);
+	const long ops = (long)kShapesPerFrame * kFrames;
+
+	// Draws kShapesPerFrame shapes a frame for kFrames frames
+	auto frames = [&](std::function<void(int)> draw) {
+		return [&window, draw] {
+			for (int frame = 0; frame < kFrames; frame++) {
+				for (int i = 0; i < kShapesPerFrame; i++)
+					draw(i);
+				window.Present();
+			}
+		};
+	};
+
+	reporter.Measure("DrawPoint", 1, ops, frames([&](int i) {
+		window.DrawPoint(color, (i * 37) % kWidth, (i * 11) % kHeight);
+	}));
+	// No two points in a row share a color, so no draw color is skipped
+	const Color alternating[] = { color, Color::kWhite };
+	reporter.Measure("DrawPoint/alternating", 1, ops, frames([&](int i) {
+		window.DrawPoint(alternating[i % 2], (i * 37) % kWidth, (i * 11) % kHeight);
+	}));
+
+	const int sizes[] = { 4, 16, 64, 256 };
+	for (int size : sizes) {
+		SDL_Rect rect{ 10, 10, size, size };
+		reporter.Measure("DrawRectangle", size, ops, frames([&](int i) {
+			rect.x = 10 + i;
+			window.DrawRectangle(color, rect);
+		}));
+		reporter.Measure("DrawFilledRectangle", size, ops, frames([&](int i) {
+			rect.x = 10 + i;
+			window.DrawFilledRectangle(color, rect);
+		}));
+	}
+
+	const int radii[] = { 1, 4, 16, 64, 100, 256 };
+	for (int radius : radii) {
+		reporter.Measure("DrawFilledCircle/per-pixel", radius, ops, frames([&](int i) {
+			window.DrawFilledCirclePerPixel(color, 400 + i, 300, radius);
+		}));
+		reporter.Measure("DrawFilledCircle", radius, ops, frames([&](int i) {
+			window.DrawFilledCircle(color, 400 + i, 300, radius);
+		}));
+		reporter.Measure("DrawCircle/per-point", radius, ops, frames([&](int i) {
+			window.DrawCirclePerPoint(color, 400 + i, 300, radius);
+		}));
+		reporter.Measure("DrawCircle", radius, ops, frames([&](int i) {
+			window.DrawCircle(color, 400 + i, 300, radius);
+		}));
+	}
+
+	const int lengths[] = { 16, 64, 256 };
+	for (int length : lengths) {
+		reporter.Measure("DrawLine", length, ops, frames([&](int i) {
+			window.DrawLine(color, 10 + i, 10, 10 + i + length, 10 + length / 2);
+		}));
+	}
+
+	// A zigzag of 64 vertices, submitted whole
+	vector<SDL_Point> zigzag(64);
+	for (size_t i = 0; i < zigzag.size(); i++)
+		zigzag[i] = SDL_Point{ 10 + (int)i * 8, i % 2 ? 10 : 60 };
+	reporter.Measure("DrawPolyline", (long)zigzag.size(), ops, frames([&](int i) {
+		window.DrawPolyline(color, zigzag.data(), zigzag.size());
+	}));
+
+	const string label = "Score: 0123456789 Lives: 3";
+	reporter.Measure("DrawString/per-point", (long)label.size(), ops, frames([&](int i) {
+		window.DrawStringPerPoint(color, 10 + i, 10 + i, label);
+	}));
+	reporter.Measure("DrawString", (long)label.size(), ops, frames([&](int i) {
+		window.DrawString(color, 10 + i, 10 + i, label);
+	}));
+}
+
+// Fills kShapesPerFrame squares a frame with each backend, opaque and
+// blended.  Operations are pixels, so ops_per_sec is the fill rate.
+static void BenchFillRate(BenchReporter& reporter) {
+	BenchWindow window;
+	const int sizes[] = { 16, 64, 256 };
+	const struct {
+		const char* name;
+		RenderBackend backend;
+		Uint8 alpha;
+	} variants[] = {
+		{ "FillRate/renderer", RenderBackend::kRenderer, 255 },
+		{ "FillRate/renderer-blend", RenderBackend::kRenderer, 128 },
+		{ "FillRate/software", RenderBackend::kSoftware, 255 },
+		{ "FillRate/software-blend", RenderBackend::kSoftware, 128 },
+	};
+	for (int size : sizes) {
+		long pixels = (long)size * size * kShapesPerFrame * kFrames;
+		for (const auto& variant : variants) {
+			window.SetRenderBackend(variant.backend);
+			Color color(255, 100, 0, variant.alpha);
+			reporter.Measure(variant.name, size, pixels, [&] {
+				for (int frame = 0; frame < kFrames; frame++) {
+					for (int i = 0; i < kShapesPerFrame; i++)
+						window.DrawFilledRectangle(color,
+							{ (i * 37) % (kWidth - size), (i * 11) % (kHeight - size), size, size });
+					window.Present();
+				}
+			});
+		}
+	}
+	window.SetRenderBackend(RenderBackend::kRenderer);
+}
+
+static void BenchPaint(BenchReporter& reporter) {
+	if (!reporter.Enabled("PostPaint"))
+		return;
+	const int counts[] = { 10, 100, 1000, 10000, 100000 };
+	for (int count : counts) {
+		BenchObjectWindow window;
+		Scene scene;
+		srand(1);
+		scene.Populate(window, count, kWidth, 24);
+		int frames = count >= 10000 ? 5 : kFrames;
+		reporter.Measure("PostPaint", count, frames, [&] {
+			for (int frame = 0; frame < frames; frame++)
+				window.RenderFrame();
+		});
+		window.SetObjectStorage(ObjectStorage::kArrays);
+		reporter.Measure("PostPaint/arrays", count, frames, [&] {
+			for (int frame = 0; frame < frames; frame++)
+				window.RenderFrame();
+		});
+		window.SetObjectStorage(ObjectStorage::kObjects);
+		window.SetDrawSorting(false);
+		reporter.Measure("PostPaint/unsorted", count, frames, [&] {
+			for (int frame = 0; frame < frames; frame++)
+				window.RenderFrame();
+		});
+		scene.Clear(window);
+	}
+}
+
+// Renders a large scene with tiled rendering on 1 to N threads, N being
+// the hardware's thread count, next to the serial software backend.
+static void BenchTiled(BenchReporter& reporter) {
+	if (!reporter.Enabled("PostPaint/software") && !reporter.Enabled("PostPaint/tiled"))
+		return;
+	const int kCount = 10000;
+	const int kTiledFrames = 10;
+	BenchObjectWindow window;
+	Scene scene;
+	srand(1);
+	scene.Populate(window, kCount, kWidth, 64);
+	window.SetRenderBackend(RenderBackend::kSoftware);
+	reporter.Measure("PostPaint/software", kCount, kTiledFrames, [&] {
+		for (int frame = 0; frame < kTiledFrames; frame++)
+			window.RenderFrame();
+	});
+
+	// Powers of two, then the full thread count
+	unsigned max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+	vector<unsigned> thread_counts;
+	for (unsigned threads = 1; threads < max_threads; threads *= 2)
+		thread_counts.push_back(threads);
+	thread_counts.push_back(max_threads);
+	for (unsigned threads : thread_counts) {
+		window.SetTiledRendering(threads);
+		reporter.Measure("PostPaint/tiled", threads, kTiledFrames, [&] {
+			for (int frame = 0; frame < kTiledFrames; frame++)
+				window.RenderFrame();
+		});
+	}
+	window.SetTiledRendering(0);
+	scene.Clear(window);
+}
+
+// Animates count splines of six control points, moving them, which
+// reuses their cached vertices, or reshaping them, which tessellates.
+static void BenchSplines(BenchReporter& reporter) {
+	if (!reporter.Enabled("Spline/"))
+		return;
+	const int counts[] = { 100, 1000 };
+	for (int count : counts) {
+		BenchObjectWindow window;
+		vector<Spline*> splines;
+		srand(1);
+		for (int i = 0; i < count; i++) {
+			SDL_Point points[6];
+			for (SDL_Point& point : points)
+				point = SDL_Point{ rand() % kWidth, rand() % kHeight };
+			splines.push_back(window.Get(window.Create<Spline>(Color(255, 255, 255), points, 6)));
+		}
+		reporter.Measure("Spline/move", count, kFrames, [&] {
+			for (int frame = 0; frame < kFrames; frame++) {
+				for (Spline* spline : splines)
+					spline->SetPosX((spline->GetPosX() + 1) % kWidth);
+				window.RenderFrame();
+			}
+		});
+		reporter.Measure("Spline/reshape", count, kFrames, [&] {
+			for (int frame = 0; frame < kFrames; frame++) {
+				for (Spline* spline : splines)
+					spline->SetControlPoint(frame % 6, rand() % kWidth, rand() % kHeight);
+				window.RenderFrame();
+			}
+		});
+	}
+}
+
+// A HUD of labels; "static" leaves them alone, "counter" rewrites one a
+// frame the way a score display would.
+static void BenchText(BenchReporter& reporter) {
+	if (!reporter.Enabled("Text/"))
+		return;
+	const int counts[] = { 10, 100 };
+	for (int count : counts) {
+		BenchObjectWindow window;
+		vector<Text*> labels;
+		for (int i = 0; i < count; i++)
+			labels.push_back(window.Get(window.Create<Text>(Color(255, 255, 255),
+				(i % 4) * 200, (i / 4) * 10 % kHeight, "Label " + std::to_string(i))));
+		reporter.Measure("Text/static", count, kFrames, [&] {
+			for (int frame = 0; frame < kFrames; frame++)
+				window.RenderFrame();
+		});
+		reporter.Measure("Text/counter", count, kFrames, [&] {
+			for (int frame = 0; frame < kFrames; frame++) {
+				labels[0]->SetText("Score: " + std::to_string(frame * 10));
+				window.RenderFrame();
+			}
+		});
+	}
+}
+
+// Moves count 16x16 tinted sprites from one atlas page each frame, next
+// to as many filled rectangles of the same size for reference.
+static void BenchSprites(BenchReporter& reporter) {
+	if (!reporter.Enabled("Sprites"))
+		return;
+	vector<Uint32> pixels(16 * 16);
+	for (size_t i = 0; i < pixels.size(); i++)
+		pixels[i] = (i % 16 + i / 16) % 4 ? 0xFFFFFFFF : 0x80FFFFFF;
+	const int counts[] = { 100, 1000, 10000 };
+	for (int count : counts) {
+		BenchObjectWindow rectangle_window, sprite_window;
+		SpriteImage image = sprite_window.AddSprite(pixels.data(), 16, 16);
+		vector<GraphicalObject*> rectangles, sprites;
+		srand(1);
+		for (int i = 0; i < count; i++) {
+			Color tint(rand() % 256, rand() % 256, rand() % 256);
+			int x = rand() % kWidth, y = rand() % kHeight;
+			rectangles.push_back(rectangle_window.Get(
+				rectangle_window.Create<Rectangle>(tint, x, y, 16, 16, true)));
+			sprites.push_back(sprite_window.Get(sprite_window.Create<Sprite>(image, x, y, tint)));
+		}
+		auto frames = [](BenchObjectWindow& window, vector<GraphicalObject*>& objects) {
+			return [&window, &objects] {
+				for (int frame = 0; frame < kFrames; frame++) {
+					for (GraphicalObject* object : objects)
+						object->SetPosX((object->GetPosX() + 1) % kWidth);
+					window.RenderFrame();
+				}
+			};
+		};
+		reporter.Measure("Sprites/rectangles", count, kFrames, frames(rectangle_window, rectangles));
+		reporter.Measure("Sprites", count, kFrames, frames(sprite_window, sprites));
+	}
+}
+
+// Panning a fixed view across worlds of count squares at one density:
+// only the few hundred in view are painted, so the cost should not grow
+// with the world.
+static void BenchCamera(BenchReporter& reporter) {
+	if (!reporter.Enabled("Camera/pan"))
+		return;
+	const int counts[] = { 10000, 100000, 1000000 };
+	for (int count : counts) {
+		BenchObjectWindow window;
+		int side = (int)std::sqrt((double)count);
+		srand(1);
+		for (int i = 0; i < count; i++) {
+			Color color(rand() % 256, rand() % 256, rand() % 256);
+			window.Create<Rectangle>(color, i % side * 40, i / side * 40, 16, 16, true);
+		}
+		float world = side * 40.0f;
+		Camera camera{ world / 2, world / 2, 1.0f };
+		window.RenderFrame();
+		reporter.Measure("Camera/pan", count, kFrames, [&] {
+			for (int frame = 0; frame < kFrames; frame++) {
+				camera.x += 7.0f;
+				camera.y += 3.0f;
+				window.SetCamera(camera);
+				window.RenderFrame();
+			}
+		});
+	}
+}
+
+// count squares that never change under 50 that move every frame, all
+// painted every frame, then with the still ones in a static layer,
+// which only the renderer backend caches.
+static void BenchLayers(BenchReporter& reporter) {
+	if (!reporter.Enabled("Layers/dynamic") && !reporter.Enabled("Layers/static"))
+		return;
+	const int counts[] = { 1000, 10000, 100000 };
+	for (int count : counts) {
+		for (int cached = 0; cached < 2; cached++) {
+			BenchObjectWindow window;
+			if (cached)
+				window.AddLayer("still", -1, LayerMode::kStatic);
+			srand(1);
+			for (int i = 0; i < count; i++) {
+				Color color(rand() % 256, rand() % 256, rand() % 256);
+				Handle<Rectangle> square = window.Create<Rectangle>(color, rand() % kWidth, rand() % kHeight, 8, 8, true);
+				if (cached)
+					window.SetLayer(window.Get(square), "still");
+			}
+			vector<GraphicalObject*> moving;
+			for (int i = 0; i < 50; i++)
+				moving.push_back(window.Get(window.Create<Circle>(Color(255, 255, 255), rand() % kWidth, rand() % kHeight, 6, true)));
+			window.RenderFrame();
+			reporter.Measure(cached ? "Layers/static" : "Layers/dynamic", count, kFrames, [&] {
+				for (int frame = 0; frame < kFrames; frame++) {
+					for (GraphicalObject* object : moving)
+						object->SetPosX((object->GetPosX() + 3) % kWidth);
+					window.RenderFrame();
+				}
+			});
+		}
+	}
+}
+
+// Moving count small squares for kFrames fixed steps: by hand with float
+// shadows as test.cpp used to, with bodies, and with bodies swept for
+// contacts.
+static void BenchBodies(BenchReporter& reporter) {
+	if (!reporter.Enabled("Bodies/scalar") && !reporter.Enabled("Bodies/contacts"))
+		return;
+	const int counts[] = { 1000, 10000 };
+	const double kStep = 1.0 / 240.0;
+	for (int count : counts) {
+		BenchObjectWindow window;
+		window.SetGridCellSize(16);
+		vector<Rectangle*> squares;
+		vector<float> x, y, v_x, v_y;
+		srand(1);
+		for (int i = 0; i < count; i++) {
+			squares.push_back(window.Get(window.Create<Rectangle>(Color(255, 255, 255),
+				rand() % kWidth, rand() % kHeight, 4, 4, true)));
+			x.push_back((float)squares.back()->GetPosX());
+			y.push_back((float)squares.back()->GetPosY());
+			v_x.push_back((float)(rand() % 200 - 100));
+			v_y.push_back((float)(rand() % 200 - 100));
+		}
+		reporter.Measure("Bodies/scalar", count, kFrames, [&] {
+			for (int frame = 0; frame < kFrames; frame++)
+				for (int i = 0; i < count; i++) {
+					squares[i]->SetPosX(int(x[i] += v_x[i] * (float)kStep));
+					squares[i]->SetPosY(int(y[i] += v_y[i] * (float)kStep));
+				}
+		});
+		for (int i = 0; i < count; i++)
+			squares[i]->SetVelocity(v_x[i], v_y[i]);
+		reporter.Measure("Bodies", count, kFrames, [&] {
+			for (int frame = 0; frame < kFrames; frame++)
+				window.StepBodies(kStep);
+		});
+		long contacts = 0;
+		window.SetContactCallback([&](Span<const Contact> found) { contacts += (long)found.size(); });
+		reporter.Measure("Bodies/contacts", count, kFrames, [&] {
+			for (int frame = 0; frame < kFrames; frame++)
+				window.StepBodies(kStep);
+		});
+		bench_sink = contacts;
+	}
+}
+
+// A mouse reporting events_per_frame motions between frames
+static void BenchInput(BenchReporter& reporter) {
+	if (!reporter.Enabled("Input/"))
+		return;
+	const int rates[] = { 1, 16, 256 };
+	for (int events_per_frame : rates) {
+		BenchPaddleWindow window;
+		auto frames = [&](std::function<void()> step) {
+			return [&window, events_per_frame, step] {
+				for (int frame = 0; frame < kFrames; frame++) {
+					for (int i = 0; i < events_per_frame; i++)
+						window.PushMotion((frame * events_per_frame + i) % kWidth);
+					step();
+				}
+			};
+		};
+		reporter.Measure("Input/per-event", events_per_frame, kFrames,
+			frames([&] { window.StepPerEvent(); }));
+		reporter.Measure("Input/coalesced", events_per_frame, kFrames,
+			frames([&] { window.Step(0.0); }));
+	}
+}
+
+// Renders a scene of 1000 shapes without recording, and recording it as
+// a Y4M stream and as PPM files, with the default ring of buffers.  The
+// recorded cases show what capture adds to the frame loop; frames the
+// writer cannot keep up with are dropped rather than waited for.
+static void BenchCapture(BenchReporter& reporter) {
+	if (!reporter.Enabled("Capture"))
+		return;
+	const int kCount = 1000;
+	BenchObjectWindow window;
+	Scene scene;
+	srand(1);
+	scene.Populate(window, kCount, kWidth, 24);
+	window.SetRenderBackend(RenderBackend::kSoftware);
+	auto frames = [&] {
+		for (int frame = 0; frame < kFrames; frame++)
+			window.RenderFrame();
+	};
+	reporter.Measure("Capture/off", kCount, kFrames, frames);
+	if (reporter.Enabled("Capture/y4m") && window.StartRecording("bench_capture.y4m", CaptureFormat::kY4m)) {
+		reporter.Measure("Capture/y4m", kCount, kFrames, frames);
+		window.StopRecording();
+		remove("bench_capture.y4m");
+	}
+	if (reporter.Enabled("Capture/ppm") && window.StartRecording("bench_capture", CaptureFormat::kPpm)) {
+		reporter.Measure("Capture/ppm", kCount, kFrames, frames);
+		window.StopRecording();
+		char name[32];
+		for (int frame = 0; frame < kFrames; frame++) {
+			snprintf(name, sizeof(name), "bench_capture%06d.ppm", frame);
+			remove(name);
+		}
+	}
+	scene.Clear(window);
+}
+
+// Scatters count small objects at constant density and times point hit
+// tests, pairwise Collision and all-pairs collision.
+static void BenchHitTesting(BenchReporter& reporter) {
+	BenchObjectWindow window;
+	const int counts[] = { 1000, 10000, 100000 };
+	const long kQueries = 10000;
+
+	for (int count : counts) {
+		Scene scene;
+		srand(1);
+		int world = (int)(std::sqrt((double)count) * 40);
+		scene.Populate(window, count, world, 16);
+
+		reporter.Measure("GetFirstHit/linear", count, kQueries, [&] {
+			for (long i = 0; i < kQueries; i++)
+				bench_sink = bench_sink + (window.GetFirstHitLinear(rand() % world, rand() % world) != nullptr);
+		});
+		reporter.Measure("GetFirstHit", count, kQueries, [&] {
+			for (long i = 0; i < kQueries; i++)
+				bench_sink = bench_sink + (window.GetFirstHit(rand() % world, rand() % world) != nullptr);
+		});
+		window.SetObjectStorage(ObjectStorage::kArrays);
+		reporter.Measure("GetFirstHit/arrays", count, kQueries, [&] {
+			for (long i = 0; i < kQueries; i++)
+				bench_sink = bench_sink + (window.GetFirstHit(rand() % world, rand() % world) != nullptr);
+		});
+		window.SetObjectStorage(ObjectStorage::kObjects);
+		reporter.Measure("Collision", count, kQueries, [&] {
+			for (long i = 0; i < kQueries; i++)
+				bench_sink = bench_sink + scene.all[rand() % count]->Collision(scene.all[rand() % count]);
+		});
+
+		// The quadratic scan is skipped where it would take minutes
+		if (count <= 10000)
+			reporter.Measure("CollisionPairs/linear", count, 1, [&] {
+				bench_sink = window.CountCollisionPairsLinear();
+			});
+		reporter.Measure("CollisionPairs", count, 1, [&] {
+			long pairs = 0;
+			window.ForEachCollisionPair([&](GraphicalObject*, GraphicalObject*) { pairs++; });
+			bench_sink = pairs;
+		});
+
+		scene.Clear(window);
+	}
+}
+
+// Adds count objects, then removes them in random order, first with
+// caller-owned objects and then with objects the window creates.
+static void BenchChurn(BenchReporter& reporter) {
+	const int counts[] = { 100, 1000, 10000, 100000 };
+	for (int count : counts) {
+		BenchObjectWindow window;
+		Scene scene;
+		srand(1);
+		auto populate = [&] { scene.Populate(window, count, kWidth, 24); };
+		if (reporter.Enabled("Add"))
+			reporter.Measure("Add", count, count, populate);
+		else
+			populate();
+		vector<GraphicalObject*> order = scene.all;
+		for (size_t i = order.size(); i > 1; i--)
+			std::swap(order[i - 1], order[rand() % i]);
+		reporter.Measure("Remove", count, count, [&] {
+			for (GraphicalObject* o : order)
+				window.Remove(o);
+		});
+
+		// The second round reuses the pool's memory from the first
+		vector<Handle<GraphicalObject>> handles;
+		for (int round = 0; round < 2; round++) {
+			handles.clear();
+			reporter.Measure(round == 0 ? "Create" : "Create/reused", count, count, [&] {
+				for (int i = 0; i < count; i++) {
+					Color color(255, 255, 255);
+					int x = rand() % kWidth, y = rand() % kWidth;
+					if (i % 2)
+						handles.push_back(window.Create<Rectangle>(color, x, y, 8, 8, true));
+					else
+						handles.push_back(window.Create<Circle>(color, x, y, 4, true));
+				}
+			});
+			for (size_t i = handles.size(); i > 1; i--)
+				std::swap(handles[i - 1], handles[rand() % i]);
+			reporter.Measure(round == 0 ? "Destroy" : "Destroy/reused", count, count, [&] {
+				for (const Handle<GraphicalObject>& handle : handles)
+					window.Destroy(handle);
+			});
+		}
+	}
+}
+
+int main(int argc, char* argv[]) {
+	string format = "csv", filter;
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--format=", 9) == 0)
+			format = argv[i] + 9;
+		else if (strncmp(argv[i], "--filter=", 9) == 0)
+			filter = argv[i] + 9;
+		else {
+			fprintf(stderr, "usage: %s [--format=csv|json] [--filter=<substring>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	BenchReporter reporter(filter);
+	BenchPrimitives(reporter);
+	BenchFillRate(reporter);
+	BenchPaint(reporter);
+	BenchTiled(reporter);
+	BenchCapture(reporter);
+	BenchSplines(reporter);
+	BenchText(reporter);
+	BenchSprites(reporter);
+	BenchCamera(reporter);
+	BenchLayers(reporter);
+	BenchInput(reporter);
+	BenchBodies(reporter);
+	BenchHitTesting(reporter);
+	BenchChurn(reporter);
+
+	if (format == "json")
+		reporter.PrintJson();
+	else
+		reporter.PrintCsv();
+	return 0;
+}
@@ -1,11 +1,27 @@
 #ifndef SGL2_H
 #define SGL2_H
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <type_traits>
+#include <typeindex>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#if defined(_WIN32)
 // TODO: change to SDL2/SDL.h
 #include <C:/SDL2-2.0.4/include/SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
 
 using std::string;
 using std::vector;
@@ -16,244 +32,2793 @@ namespace sgl2 {
 	using MouseMotionEvent = SDL_MouseMotionEvent;
 	using MouseButtonEvent = SDL_MouseButtonEvent;
 	using WindowEvent = SDL_WindowEvent;
+	using Event = SDL_Event;
 
+	/* A color packed into one 32-bit ARGB8888 value, the pixel format of
+	*  the software framebuffer and of every texture sgl2 creates, so that
+	*  GetArgb() can be written to a pixel as is and two colors compare
+	*  with a single integer comparison. */
 	class Color {
-	public:
-		Uint8 red;
-		Uint8 green;
-		Uint8 blue;
-		Uint8 alpha;
+	private:
+		Uint32 argb_;
 
-		/** Initializes a Color object.  The constructor
-		*   enforces clamped RGB values (0...255).
+	public:
+		/** Initializes a Color object.
 		*   @param r the red component of the color
 		*   @param g the green component of the color
 		*   @param b the blue component of the color
 		*   @param a the alpha channel of the color
 		*/
-		Color(Uint8 r, Uint8 g, Uint8 b, Uint8 a = 255);
-	};
-
-	class Window {
-	protected:
-		SDL_Window* window_;
-		SDL_Renderer* renderer_;
-		Color background_color_;
-		bool invalid_;  // calling this invalid to match up with what most graphics libraries call it
-		bool running_;
-
-	public:
-		/*!
-		Creates a window with title, dimensions, and background color.
-		*/
-		Window(const string& title, int width, int height, const Color& background);
-
-		/*!
-		Sets the background color of the window.
-		*/
-		void SetBackgroundColor(const Color& color);
+		constexpr Color(Uint8 r, Uint8 g, Uint8 b, Uint8 a = 255);
 
-		/*!
-		Key press event handler. Override this to handle key presses.
-		@param key 
+		/** Makes a Color from a packed ARGB8888 pixel value.
+		*   @param argb alpha in the top byte, then red, green and blue
 		*/
-		virtual void KeyPressed(const KeyboardEvent & event);
+		static constexpr Color FromArgb(Uint32 argb);
 
 		//TODO: add docs
-		virtual void MouseMoved(const MouseMotionEvent & event);
+		constexpr Uint8 GetRed() const;
 
 		//TODO: add docs
-		virtual void MousePressed(const MouseButtonEvent& event);
+		constexpr Uint8 GetGreen() const;
 
 		//TODO: add docs
-		virtual void MouseReleased(const MouseButtonEvent& event);
+		constexpr Uint8 GetBlue() const;
 
 		//TODO: add docs
-		virtual void MouseEntered();
+		constexpr Uint8 GetAlpha() const;
 
-		//TODO: add docs
-		virtual void MouseExited();
+		/** Returns the color as an ARGB8888 pixel value.
+		*/
+		constexpr Uint32 GetArgb() const;
+
+		static const Color kBlack;
+		static const Color kWhite;
+		static const Color kRed;
+		static const Color kGreen;
+		static const Color kBlue;
+		static const Color kYellow;
+		static const Color kCyan;
+		static const Color kMagenta;
+		static const Color kTransparent;
+	};
 
-		//TODO: add docs
-		virtual void PrePaint();
+	constexpr bool operator==(const Color& lhs, const Color& rhs);
+	constexpr bool operator!=(const Color& lhs, const Color& rhs);
+
+	/* Primitive kinds that can be recorded in a DrawList */
+	enum class DrawKind {
+		kPoint,
+		kRectangle,
+		kFilledRectangle,
+		kCircle,
+		kFilledCircle,
+		kPolyline,
+		kText,
+		kSprite
+	};
 
-		/*!
-		Must override. Handles drawing objects, called when the window needs to be repainted.
-		*/
-		virtual void Paint() = 0;
+	/* One recorded primitive.  rect is both the geometry and the screen
+	*  bounds of the primitive: a point is a 1x1 rect and a circle is the
+	*  (2 * radius + 1) square centered on it.  The rect of a polyline or
+	*  text only bounds its vertices or glyphs, which are kept in the
+	*  DrawList.  A sprite's rect is where it is drawn and its color the
+	*  tint. */
+	struct DrawCommand {
+		DrawKind kind;
+		Color color;
+		SDL_Rect rect;
+		Uint32 first_item;  // index into DrawList::Vertices(), Glyphs() or Sprites()
+		Uint32 item_count;
+	};
 
-		//TODO: add docs
-		virtual void PostPaint();
+	/* One glyph of a string: its pixels in a GlyphAtlas and where they go */
+	struct GlyphQuad {
+		SDL_Rect source;
+		SDL_Rect dest;
+	};
 
-		//TODO: add docs
-		void PaintAll();
+	/* An image's place in a SpriteAtlas */
+	struct SpriteImage {
+		int page;  // -1 for no image
+		SDL_Rect source;
+	};
 
-		//TODO: add docs
-		void Repaint();
+	/* One sprite to draw: its pixels in a SpriteAtlas, where they go and
+	*  the color they are modulated with */
+	struct SpriteQuad {
+		SDL_Rect source;
+		SDL_Rect dest;
+		Color tint;
+		int page;
+	};
+
+	/* A run of sorted commands that share a kind and color, or for
+	*  sprites an atlas page, and can be submitted with one state change
+	*  and one batched SDL call. */
+	struct DrawBatch {
+		DrawKind kind;
+		Color color;
+		int page;  // atlas page of a kSprite batch, else 0
+		SDL_Rect bounds;  // union of the bounds of every command in the batch
+		size_t first;  // index of the first command in DrawList::Commands()
+		size_t count;
+	};
+
+	/* Per-frame renderer counters. */
+	struct RenderCounters {
+		unsigned draw_calls;  // SDL_Render* submissions
+		unsigned state_changes;  // SDL_SetRenderDrawColor calls
+		unsigned objects_painted;  // GraphicalObject::Paint calls
+	};
+
+	/* What part of the world an ObjectWindow shows: the world point at the
+	*  window's top left corner, and the pixels one world unit spans. */
+	struct Camera {
+		float x;
+		float y;
+		float zoom;
+	};
+
+	/*!
+	A list of primitives recorded during a frame.  Commands are recorded in
+	painting order and Sort() groups them into batches of the same kind and
+	color.  A command only moves ahead of earlier commands that it does not
+	overlap, so the result looks the same as drawing in recorded order.
+	*/
+	class DrawList {
+	private:
+		vector<DrawCommand> recorded_;
+		vector<DrawCommand> sorted_;
+		vector<DrawBatch> batches_;
+		vector<size_t> batch_of_;  // batch index of each recorded command
+		vector<SDL_Point> vertices_;  // of every recorded polyline
+		vector<GlyphQuad> glyphs_;  // of every recorded string
+		vector<SpriteQuad> sprites_;  // of every recorded sprite
+
+	public:
+		/* How many batches back Sort() looks for a match, which bounds
+		*  its cost when a frame uses many distinct colors. */
+		static const size_t kMaxLookback = 64;
 
 		//TODO: add docs
-		void DrawPoint(Color color, int x, int y);
+		void Clear();
 
 		//TODO: add docs
-		void DrawPoint(int x, int y);
+		void AddPoint(Color color, int x, int y);
 
 		//TODO: add docs
-		void DrawRectangle(Color color, const SDL_Rect& rect);
+		void AddRectangle(Color color, const SDL_Rect& rect, bool filled);
 
 		//TODO: add docs
-		void DrawFilledRectangle(Color color, const SDL_Rect& rect);
+		void AddCircle(Color color, int x, int y, int radius, bool filled);
 
-		void EightOcts(int edge_x, int edge_y, int center_x, int center_y);
+		/*!
+		Records a polyline through count points, each offset by (x, y).
+		*/
+		void AddPolyline(Color color, const SDL_Point* points, size_t count, int x = 0, int y = 0);
 
-		//TODO: add docs
-		void DrawCircle(Color, int x, int y, int radius);
+		/*!
+		Records a string laid out as count glyphs, each offset by (x, y).
+		*/
+		void AddGlyphs(Color color, const GlyphQuad* glyphs, size_t count, int x = 0, int y = 0);
 
-		//TODO: add docs
-		void DrawFilledCircle(Color color, int x, int y, int radius);
+		/*!
+		Records image drawn scaled to dest, modulated by tint.  An image
+		with no page records nothing.
+		*/
+		void AddSprite(const SpriteImage& image, const SDL_Rect& dest, Color tint);
 
-		//TODO: add docs
-		virtual void Update();
+		/*!
+		Moves every recorded command from world coordinates to the screen
+		as seen through camera, and drops those that land outside visible.
+		Shapes scale with the zoom; points and outlines stay one pixel
+		wide.  Call it before Sort().
+		*/
+		void ApplyCamera(const Camera& camera, const SDL_Rect& visible);
 
 		/*!
-		Runs the main loop, which handles rendering, events, and updates.
+		Groups the recorded commands into batches.  When merge is false
+		every command becomes its own batch, which reproduces immediate-mode
+		drawing and is useful for measuring what batching saves.
 		*/
-		void Run();
+		void Sort(bool merge = true);
 
 		/*!
-		Closes the window.
+		Returns the commands in batch order.  Valid after Sort().
 		*/
-		void Quit();
-	};
+		const vector<DrawCommand>& Commands() const;
 
-	/* forward declaration */
-	class ObjectWindow;
+		/*!
+		Returns the batches built by the last Sort().
+		*/
+		const vector<DrawBatch>& Batches() const;
 
-	class GraphicalObject {
-	protected:
-		ObjectWindow* window_;
-		SDL_Rect rect_;
-		Color color_;
-		bool filled_;
+		/*!
+		Returns the vertices of the recorded polylines.
+		*/
+		const vector<SDL_Point>& Vertices() const;
 
-	public:
-		/* Unique identifier for object */
-		const unsigned id_;
+		/*!
+		Returns the glyphs of the recorded strings.
+		*/
+		const vector<GlyphQuad>& Glyphs() const;
 
-		//TODO: add docs
-		GraphicalObject(ObjectWindow* window, Color color);
+		/*!
+		Returns the quads of the recorded sprites.
+		*/
+		const vector<SpriteQuad>& Sprites() const;
 
 		//TODO: add docs
-		GraphicalObject(ObjectWindow* window, Color color, bool filled);
+		size_t Size() const;
+	};
 
-		//TODO: add docs
-		GraphicalObject(ObjectWindow* window, Color color, int x, int y);
+	/* An ObjectWindow scene as the simulation thread of a pipelined Run
+	*  left it: every object's position, size and color, in draw order. */
+	struct SceneSnapshot {
+		DrawList draw_list;  // sorted
+		Color background = Color::kBlack;
+		unsigned objects = 0;  // objects recorded into draw_list
+	};
 
-		//TODO: add docs
-		virtual void Paint() = 0;
+	/* Counters reported by ShapeCache::GetStats */
+	struct ShapeCacheStats {
+		unsigned long hits;
+		unsigned long misses;
+		unsigned long evictions;
+		size_t entries;
+		size_t bytes_used;
+	};
 
-		//TODO: add docs
-		int GetPosX();
+	/*!
+	A least-recently-used cache of rasterized shapes, owned by a Window.
+	Each entry is a texture keyed by a 64-bit shape key.  The total size of
+	the cached textures is kept under a byte budget by evicting the least
+	recently drawn entries.
+	*/
+	class ShapeCache {
+	private:
+		struct Entry {
+			Uint64 key;
+			SDL_Texture* texture;
+			size_t bytes;
+		};
 
-		//TODO: add docs
-		int GetPosY();
+		std::list<Entry> lru_;  // most recently used first
+		std::unordered_map<Uint64, std::list<Entry>::iterator> index_;
+		size_t budget_;
+		size_t bytes_used_;
+		ShapeCacheStats stats_;
 
-		//TODO: add docs
-		void SetPosX(int x);
+		void EvictTo(size_t budget);
 
-		//TODO: add docs
-		void SetPosY(int y);
+	public:
+		static const size_t kDefaultBudget = 16 << 20;
 
 		//TODO: add docs
-		int GetWidth();
+		explicit ShapeCache(size_t budget = kDefaultBudget);
 
-		//TODO: add docs
-		int GetHeight();
+		ShapeCache(const ShapeCache&) = delete;
+		ShapeCache& operator=(const ShapeCache&) = delete;
+		ShapeCache(ShapeCache&&) = default;
+		ShapeCache& operator=(ShapeCache&&) = default;
 
-		//TODO: add docs
-		void SetWidth(int width);
+		/*!
+		Destroys every cached texture.
+		*/
+		~ShapeCache();
 
-		//TODO: add docs
-		void SetHeight(int height);
+		/*!
+		Returns the key of a circle with the given radius, color and fill.
+		*/
+		static Uint64 CircleKey(int radius, Color color, bool filled);
 
-		//TODO: add docs
-		void SetFilled(bool filled);
+		/*!
+		Returns the cached texture for key and marks it most recently used,
+		or returns nullptr.  Counts a hit or a miss.
+		*/
+		SDL_Texture* Find(Uint64 key);
 
-		//TODO: add docs
-		bool Hit(int x, int y);
+		/*!
+		Takes ownership of texture, evicting older entries until it fits.
+		Returns false, and leaves texture with the caller, if it is larger
+		than the whole budget.
+		*/
+		bool Insert(Uint64 key, SDL_Texture* texture, size_t bytes);
 
-		//TODO: add docs
-		bool Collision(GraphicalObject* obj);
+		/*!
+		Drops the entry for key, if any.
+		*/
+		void Erase(Uint64 key);
 
-	private:
-		static unsigned id_source_;
-	};
+		/*!
+		Drops every entry.
+		*/
+		void Clear();
+
+		/*!
+		Sets the byte budget, evicting entries if the cache is now over it.
+		A budget of zero disables caching.
+		*/
+		void SetBudget(size_t bytes);
 
-	class Point : public GraphicalObject {
-	public:
 		//TODO: add docs
-		Point(ObjectWindow* window, Color color, int x, int y);
+		size_t GetBudget() const;
 
 		//TODO: add docs
-		void Paint() override;
+		ShapeCacheStats GetStats() const;
+
+		/*!
+		Zeroes the hit, miss and eviction counters.
+		*/
+		void ResetStats();
 	};
 
-	class Rectangle : public GraphicalObject {
+	/*!
+	A monochrome bitmap font of fixed-size glyphs for a run of characters.
+	Each glyph is width bytes, one per column, with bit 0 the top row, so
+	glyphs are at most 8 pixels tall.
+	*/
+	struct BitmapFont {
+		int width;
+		int height;
+		int first;  // character of the first glyph
+		int count;
+		const Uint8* columns;  // count * width bytes
+	};
+
+	/*!
+	The glyphs of a BitmapFont rasterized once and packed into a coverage
+	bitmap, kGlyphsPerRow to a row with a pixel of padding around each, so
+	a whole string can be drawn from one texture.  Windows upload it to a
+	texture on first use; the software backend reads it directly.
+	*/
+	class GlyphAtlas {
+	private:
+		BitmapFont font_;
+		int width_;
+		int height_;
+		vector<Uint8> coverage_;  // 255 where a glyph pixel is set, else 0
+		vector<SDL_Rect> glyphs_;  // atlas rect of each glyph
+
 	public:
+		static const int kGlyphsPerRow = 16;
+
 		//TODO: add docs
-		Rectangle(ObjectWindow* window, Color color, int x, int y, int width,
-			int height);
+		explicit GlyphAtlas(const BitmapFont& font);
+
+		/*!
+		Returns the atlas of the built-in 5x7 font, which covers printable
+		ASCII.
+		*/
+		static const GlyphAtlas& BuiltIn();
 
 		//TODO: add docs
-		Rectangle(ObjectWindow* window, Color color, int x, int y, int width,
-			int height, bool filled);
+		int GetWidth() const;
 
 		//TODO: add docs
-		void Paint() override;
+		int GetHeight() const;
+
+		/*!
+		Returns GetHeight() rows of GetWidth() coverage values.
+		*/
+		const Uint8* GetCoverage() const;
+
+		/*!
+		Lays text out at scale, appending a quad per visible glyph to
+		quads, with dest relative to the text's top left corner.  Glyphs
+		advance by the font width plus one pixel, '\n' starts a new line
+		and characters the font lacks show as '?'.  Returns the size of
+		the text.
+		*/
+		SDL_Point Layout(const string& text, int scale, vector<GlyphQuad>& quads) const;
 	};
 
-	class Circle : public GraphicalObject {
+	/*!
+	Images packed into pages of ARGB8888 pixels, so sprites drawn from the
+	same page share one texture and one batched draw call.  Each page is
+	filled in shelves: an image goes on the lowest shelf it fits with the
+	least height to spare, or on a new shelf, or on a new page.  Images
+	larger than a page get a page of their own.  A pixel of padding keeps
+	neighbours from bleeding into scaled sprites.  Pages are uploaded to
+	a texture the first time they are drawn after a change; the software
+	backend reads them directly.
+	*/
+	class SpriteAtlas {
+	private:
+		struct Shelf {
+			int y;
+			int height;
+			int used;  // width taken from the left
+		};
+
+		struct Page {
+			int width;
+			int height;
+			vector<Uint32> pixels;
+			vector<Shelf> shelves;
+			int used_height;  // rows taken by shelves
+			SDL_Texture* texture;  // nullptr until first drawn
+			bool dirty;  // pixels changed since the texture was uploaded
+		};
+
+		vector<Page> pages_;
+		int page_size_;
+
+		/*!
+		Finds room for a width by height image, with padding, making a
+		new shelf or page if needed.  Returns the page and the image's
+		rect in it.
+		*/
+		int Allocate(int width, int height, SDL_Rect& rect);
+
 	public:
+		static const int kDefaultPageSize = 1024;
+
 		//TODO: add docs
-		Circle(ObjectWindow* window, Color color, int x, int y, int radius);
+		explicit SpriteAtlas(int page_size = kDefaultPageSize);
+
+		SpriteAtlas(const SpriteAtlas&) = delete;
+		SpriteAtlas& operator=(const SpriteAtlas&) = delete;
+		SpriteAtlas(SpriteAtlas&&) = default;
+		SpriteAtlas& operator=(SpriteAtlas&&) = default;
+
+		/*!
+		Destroys the page textures.
+		*/
+		~SpriteAtlas();
+
+		/*!
+		Copies height rows of width ARGB8888 pixels, pitch bytes apart,
+		into the atlas.  Returns an image with no page if the size is not
+		positive.
+		*/
+		SpriteImage Add(const Uint32* pixels, int width, int height, int pitch);
+
+		/*!
+		Loads a BMP file into the atlas.  Returns an image with no page if
+		it cannot be read.
+		*/
+		SpriteImage LoadBmp(const string& path);
 
 		//TODO: add docs
-		Circle(ObjectWindow* window, Color color, int x, int y, int radius, bool filled);
+		int GetPageCount() const;
 
 		//TODO: add docs
-		void SetRadius(int radius);
+		int GetPageWidth(int page) const;
 
 		//TODO: add docs
-		void Paint() override;
+		int GetPageHeight(int page) const;
+
+		/*!
+		Returns GetPageHeight() rows of GetPageWidth() pixels.
+		*/
+		const Uint32* GetPixels(int page) const;
+
+		/*!
+		Returns the page's texture for renderer, uploading the page first
+		if it changed.  Returns nullptr if the texture cannot be made.
+		*/
+		SDL_Texture* GetTexture(SDL_Renderer* renderer, int page);
+
+		/*!
+		Drops every image and page.
+		*/
+		void Clear();
 	};
 
-	class ObjectWindow : public Window {
-	protected:
-		vector<GraphicalObject*> objects_;
+	/* Where Window rasterizes its primitives */
+	enum class RenderBackend {
+		kRenderer,  // SDL_Render* calls on the window's renderer
+		kSoftware  // a SoftwareRasterizer on the CPU, uploaded once per frame
+	};
+
+	/*!
+	Draws into an ARGB8888 framebuffer on the CPU.  Spans are filled eight
+	pixels at a time with AVX2 or four with SSE2 when the compiler targets
+	them, and colors with alpha below 255 are blended source-over, like
+	SDL_BLENDMODE_BLEND.  Everything but Clear is clipped to the clip rect.
+	*/
+	class SoftwareRasterizer {
+	private:
+		vector<Uint32> pixels_;
+		int width_;
+		int height_;
+		SDL_Rect clip_;  // always inside the framebuffer
+
+		/*!
+		Fills count pixels starting at row with color, blending unless
+		blend is false or the color is opaque.
+		*/
+		static void FillSpan(Uint32* row, int count, Color color, bool blend);
+
+		/* The drawing operations, limited to clip, which must lie inside
+		*  the framebuffer.  They only write pixels inside clip. */
+		void FillRectsClipped(const SDL_Rect* rects, size_t count, Color color, bool blend,
+			const SDL_Rect& clip);
+		void DrawRectsClipped(const SDL_Rect* rects, size_t count, Color color,
+			const SDL_Rect& clip);
+		void DrawPointsClipped(const SDL_Point* points, size_t count, Color color,
+			const SDL_Rect& clip);
+		void DrawLinesClipped(const SDL_Point* points, size_t count, Color color,
+			const SDL_Rect& clip);
+		void DrawGlyphsClipped(const GlyphAtlas& atlas, const GlyphQuad* glyphs, size_t count,
+			Color color, const SDL_Rect& clip);
+		void DrawSpritesClipped(const SpriteAtlas& atlas, const SpriteQuad* sprites, size_t count,
+			const SDL_Rect& clip);
 
 	public:
 		//TODO: add docs
-		ObjectWindow(const string& title, int width, int height,
-			const Color& background);
+		SoftwareRasterizer();
+
+		/*!
+		Resizes the framebuffer, clearing it to transparent black.
+		*/
+		void Resize(int width, int height);
 
 		//TODO: add docs
-		void PrePaint() override;
-		
+		int GetWidth() const;
+
 		//TODO: add docs
-		void Paint() override;
-		
+		int GetHeight() const;
+
+		/*!
+		Returns GetHeight() rows of GetPitch() bytes of ARGB8888 pixels.
+		*/
+		const Uint32* GetPixels() const;
+
 		//TODO: add docs
-		void PostPaint() override;
+		int GetPitch() const;
+
+		/*!
+		Limits drawing to rect, or to the whole framebuffer if rect is
+		nullptr.
+		*/
+		void SetClipRect(const SDL_Rect* rect);
+
+		/*!
+		Sets every pixel to color, ignoring the clip rect and without
+		blending, like SDL_RenderClear.
+		*/
+		void Clear(Color color);
+
+		/*!
+		Sets the pixels of every rect to color without blending.
+		*/
+		void ClearRects(const SDL_Rect* rects, size_t count, Color color);
 
 		//TODO: add docs
-		void Add(GraphicalObject* obj);
+		void FillRects(const SDL_Rect* rects, size_t count, Color color);
+
+		/*!
+		Draws the one pixel wide outline of every rect, touching each
+		pixel once so corners are not blended twice.
+		*/
+		void DrawRects(const SDL_Rect* rects, size_t count, Color color);
 
 		//TODO: add docs
-		void Remove(GraphicalObject* obj);
+		void DrawPoints(const SDL_Point* points, size_t count, Color color);
 
 		/*!
-		Returns a pointer to the first GraphicalObject found that intersects with the point (x, y). Returns nullptr if no object found. 
+		Draws Bresenham lines joining count points, like
+		SDL_RenderDrawLines.  Each joint is drawn once, so a color with
+		alpha is not blended twice where the lines meet.
 		*/
-		GraphicalObject* GetFirstHit(int x, int y);
+		void DrawLines(const SDL_Point* points, size_t count, Color color);
+
+		/*!
+		Draws the covered pixels of every glyph's source in atlas, scaled
+		to its dest with nearest sampling, in color.
+		*/
+		void DrawGlyphs(const GlyphAtlas& atlas, const GlyphQuad* glyphs, size_t count, Color color);
+
+		/*!
+		Draws every sprite's source in atlas scaled to its dest with
+		nearest sampling, each pixel modulated by the tint and blended by
+		its alpha.
+		*/
+		void DrawSprites(const SpriteAtlas& atlas, const SpriteQuad* sprites, size_t count);
+
+		/*!
+		Draws one command of list, limited to clip intersected with the
+		framebuffer, with the same pixels as Window::DrawCommands.  Text
+		is drawn from font and sprites from sprites, and spans and points
+		are scratch space.  Ignores the clip rect, so calls on different
+		threads with disjoint clips never touch the same pixel.
+		*/
+		void RasterizeCommand(const DrawCommand& command, const DrawList& list, const GlyphAtlas& font,
+			const SpriteAtlas& sprites, const SDL_Rect& clip, vector<SDL_Rect>& spans,
+			vector<SDL_Point>& points);
+	};
+
+	/*!
+	A fixed set of threads that run the iterations of ParallelFor.  The
+	calling thread works too, so a pool of one thread runs everything
+	inline.
+	*/
+	class WorkerPool {
+	private:
+		struct Shared {
+			std::mutex mutex;
+			std::condition_variable wake;
+			std::condition_variable done;
+			const std::function<void(size_t, unsigned)>* job;
+			size_t count;
+			std::atomic<size_t> next;
+			unsigned busy;  // workers still running the current job
+			unsigned long generation;  // bumped for every job
+			bool stopping;
+		};
+
+		std::unique_ptr<Shared> shared_;
+		vector<std::thread> threads_;
+
+		/* Runs iterations of the current job until none are left */
+		static void Work(Shared& shared, unsigned thread);
+
+		static void WorkerMain(Shared* shared, unsigned thread);
+
+	public:
+		/*!
+		Starts threads - 1 worker threads.
+		*/
+		explicit WorkerPool(unsigned threads);
+
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool& operator=(const WorkerPool&) = delete;
+
+		//TODO: add docs
+		~WorkerPool();
+
+		/*!
+		Returns the number of threads that run jobs, the caller included.
+		*/
+		unsigned GetThreadCount() const;
+
+		/*!
+		Calls job(i, thread) for every i below count, spread over the
+		threads, and returns when every call has returned.  thread is
+		below GetThreadCount() and no two calls running at once share it,
+		so it can index per-thread scratch space.
+		*/
+		void ParallelFor(size_t count, const std::function<void(size_t, unsigned)>& job);
+	};
+
+	/*!
+	Hands the latest of a stream of values from one producer thread to one
+	consumer thread without locking.  The producer fills Back() and calls
+	Publish(); the consumer calls Acquire() and reads Front().  Of the
+	three slots each thread owns one and the third is traded through an
+	atomic index, so neither thread ever waits for the other, and values
+	published between two Acquire() calls are skipped.
+	*/
+	template <typename T>
+	class TripleBuffer {
+	private:
+		T slots_[3];
+		std::atomic<unsigned> middle_;  // index of the traded slot, with kFresh while unread
+		unsigned back_;  // producer's slot
+		unsigned front_;  // consumer's slot
+
+		static const unsigned kFresh = 4;
+
+	public:
+		TripleBuffer();
+
+		TripleBuffer(const TripleBuffer&) = delete;
+		TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+		/*!
+		Returns the slot the producer fills next.  It still holds whatever
+		value was last published from it, so its buffers can be reused.
+		*/
+		T& Back();
+
+		/*!
+		Makes the back slot the newest value and takes another to fill.
+		*/
+		void Publish();
+
+		/*!
+		Makes the newest published value the front one.  Returns false,
+		keeping the front value, if nothing was published since the last
+		call.
+		*/
+		bool Acquire();
+
+		/*!
+		Returns the value taken by the last successful Acquire(), or a
+		default constructed one before that.
+		*/
+		const T& Front() const;
+	};
+
+	/* How FrameRecorder stores what it captures */
+	enum class CaptureFormat {
+		kRaw,  // one file of tightly packed ARGB8888 pixels per frame
+		kPpm,  // one binary PPM (P6) image per frame
+		kY4m  // a single YUV4MPEG2 stream, 4:4:4, BT.601 video range
+	};
+
+	/* What FrameRecorder does with a new frame while every buffer is
+	*  waiting for the writer */
+	enum class CaptureDropPolicy {
+		kDropNewest,  // skips the new frame
+		kDropOldest  // reuses the buffer of the oldest frame not yet being written
+	};
+
+	/* Frame counts of a recording */
+	struct CaptureStats {
+		unsigned long offered;  // frames handed to the recorder
+		unsigned long written;
+		unsigned long dropped;  // by the drop policy
+		unsigned long failed;  // not read back or not written
+	};
+
+	/*!
+	Records frames to disk on a writer thread.  Frames are read into a
+	ring of buffers allocated by Start(), and the writer encodes and
+	writes them in order while the frame loop goes on; the frame loop only
+	ever takes a lock to trade a buffer index, never to wait for I/O.
+	When the writer falls behind and every buffer is queued, frames are
+	dropped by the drop policy instead.
+	*/
+	class FrameRecorder {
+	private:
+		struct Shared {
+			std::mutex mutex;
+			std::condition_variable wake;
+			vector<vector<Uint32>> buffers;  // all allocated by Start
+			vector<size_t> free;  // buffers nobody holds
+			vector<size_t> queue;  // ring of buffers waiting for the writer, oldest at head
+			vector<unsigned long> numbers;  // frame number of each buffer
+			size_t head;
+			size_t queued;
+			CaptureStats stats;
+			bool stopping;
+		};
+
+		std::unique_ptr<Shared> shared_;
+		std::thread writer_;
+		string path_;
+		CaptureFormat format_;
+		CaptureDropPolicy policy_;
+		int width_;
+		int height_;
+		std::unique_ptr<FILE, int(*)(FILE*)> stream_;  // the kY4m file
+		vector<Uint8> encoded_;  // writer's scratch buffer
+		size_t filling_;  // buffer the frame loop is filling, or kNoBuffer
+
+		static const size_t kNoBuffer = (size_t)-1;
+
+		/* Writes queued frames until Stop() and the queue is empty */
+		void WriterMain();
+
+		/* Encodes and writes one frame; returns false on an I/O error */
+		bool WriteFrame(const vector<Uint32>& pixels, unsigned long number);
+
+	public:
+		/* Buffers Start() allocates unless told otherwise */
+		static const size_t kDefaultBuffers = 4;
+
+		//TODO: add docs
+		FrameRecorder();
+
+		FrameRecorder(const FrameRecorder&) = delete;
+		FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+		/*!
+		Stops the recording, writing out the frames still queued.
+		*/
+		~FrameRecorder();
+
+		/*!
+		Starts recording width by height frames to path, stopping any
+		recording in progress.  A kY4m stream is written to path at fps
+		frames per second; the other formats write one file per frame
+		named path followed by the six digit frame number and ".raw" or
+		".ppm".  Allocates buffers frame buffers up front.  Returns false
+		if the stream cannot be opened.
+		*/
+		bool Start(const string& path, CaptureFormat format, int width, int height,
+			int fps = 60, size_t buffers = kDefaultBuffers,
+			CaptureDropPolicy policy = CaptureDropPolicy::kDropOldest);
+
+		/*!
+		Waits for the writer to finish the queued frames and closes the
+		recording.
+		*/
+		void Stop();
+
+		//TODO: add docs
+		bool IsRecording() const;
+
+		/*!
+		Returns a buffer of width * height pixels to read the next frame
+		into, or nullptr if the frame is dropped.  Every non-null return
+		must be followed by SubmitFrame().
+		*/
+		Uint32* AcquireFrame();
+
+		/*!
+		Queues the frame read into the buffer of AcquireFrame() for the
+		writer, or frees the buffer again if filled is false.
+		*/
+		void SubmitFrame(bool filled);
+
+		/*!
+		Returns the counts of the current or last recording.
+		*/
+		CaptureStats GetStats() const;
+	};
+
+	/*!
+	A view of count contiguous values owned by someone else, standing in
+	for C++20's std::span.  It must not outlive what it views.
+	*/
+	template <typename T>
+	class Span {
+	private:
+		T* data_;
+		size_t size_;
+
+	public:
+		Span();
+
+		Span(T* data, size_t size);
+
+		/*!
+		Views all of values.
+		*/
+		template <typename U>
+		Span(const vector<U>& values);
+
+		//TODO: add docs
+		T* begin() const;
+
+		//TODO: add docs
+		T* end() const;
+
+		//TODO: add docs
+		T* data() const;
+
+		//TODO: add docs
+		size_t size() const;
+
+		//TODO: add docs
+		bool empty() const;
+
+		//TODO: add docs
+		T& operator[](size_t index) const;
+	};
+
+	/*!
+	Keyboard and mouse state as of the events of the current frame, kept
+	in arrays so it can be queried cheaply from any handler or Update.
+	Besides whether a key or button is held, it remembers which went down
+	or up during the frame, and the mouse motion the frame's events add
+	up to.
+	*/
+	class InputState {
+	private:
+		Uint8 keys_[SDL_NUM_SCANCODES];  // kDown | kPressed | kReleased, by scancode
+		Uint8 buttons_[8];  // the same, by SDL mouse button number
+		SDL_Point mouse_;  // last reported position
+		SDL_Point motion_;  // accumulated this frame
+
+		static const Uint8 kDown = 1;
+		static const Uint8 kPressed = 2;
+		static const Uint8 kReleased = 4;
+
+		static Uint8 Press(Uint8 state);
+		static Uint8 Release(Uint8 state);
+
+	public:
+		InputState();
+
+		/*!
+		Forgets the frame's presses, releases and motion, keeping what is
+		held and the mouse position.
+		*/
+		void BeginFrame();
+
+		/*!
+		Folds event into the state.  Key repeats do not count as presses.
+		*/
+		void Apply(const Event& event);
+
+		/*!
+		Returns whether the key is held down.
+		*/
+		bool IsKeyDown(SDL_Scancode key) const;
+
+		/*!
+		Returns whether the key went down during the frame.
+		*/
+		bool WasKeyPressed(SDL_Scancode key) const;
+
+		/*!
+		Returns whether the key went up during the frame.
+		*/
+		bool WasKeyReleased(SDL_Scancode key) const;
+
+		/*!
+		Returns whether the mouse button (SDL_BUTTON_LEFT and so on) is
+		held down.
+		*/
+		bool IsButtonDown(int button) const;
+
+		//TODO: add docs
+		bool WasButtonPressed(int button) const;
+
+		//TODO: add docs
+		bool WasButtonReleased(int button) const;
+
+		/*!
+		Returns the last reported mouse position.
+		*/
+		SDL_Point GetMousePosition() const;
+
+		/*!
+		Returns how far the mouse moved during the frame.
+		*/
+		SDL_Point GetMouseMotion() const;
+	};
+
+	/*!
+	Writes the input of a session to a binary log that InputPlayer reads
+	back.  The log starts with a seed for rand() and then holds one record
+	per frame: the seconds the frame advanced time by, stored bit for bit
+	so fixed-timestep replays take the same steps, and the keyboard, mouse
+	button, mouse motion, enter/leave and quit events polled during it as
+	variable-length integers.  Frames with no events take nine bytes.
+	*/
+	class InputRecorder {
+	private:
+		std::unique_ptr<FILE, int(*)(FILE*)> file_;
+		vector<Uint8> frame_;  // the frame being encoded, written with one fwrite
+
+	public:
+		//TODO: add docs
+		InputRecorder();
+
+		/*!
+		Starts a log at path, closing any log already open, and writes
+		seed to it.  Returns false if the file cannot be opened.
+		*/
+		bool Open(const string& path, Uint32 seed);
+
+		//TODO: add docs
+		void Close();
+
+		//TODO: add docs
+		bool IsOpen() const;
+
+		/*!
+		Appends a frame that advanced time by elapsed seconds with events.
+		Events of other types are left out.
+		*/
+		void WriteFrame(double elapsed, const vector<Event>& events);
+	};
+
+	/*!
+	Reads a log written by InputRecorder, one frame at a time.  Events
+	come back with everything the log keeps; the rest of each SDL_Event is
+	zero, except the timestamp, the milliseconds of logged time before it.
+	*/
+	class InputPlayer {
+	private:
+		vector<Uint8> data_;  // the whole log
+		size_t offset_;  // start of the next frame
+		Uint32 seed_;
+		double clock_;  // logged seconds read so far
+
+	public:
+		//TODO: add docs
+		InputPlayer();
+
+		/*!
+		Reads the log at path.  Returns false if it cannot be read or is
+		not an input log.
+		*/
+		bool Open(const string& path);
+
+		/*!
+		Returns the seed the log was recorded with.
+		*/
+		Uint32 GetSeed() const;
+
+		/*!
+		Reads the next frame into elapsed and events, replacing what events
+		held.  Returns false at the end of the log, or at a truncated frame.
+		*/
+		bool ReadFrame(double& elapsed, vector<Event>& events);
+	};
+
+	/* Where a Window renders */
+	enum class WindowMode {
+		kShown,  // an on-screen SDL window with the default renderer
+		kOffscreen  // a software renderer drawing into an in-memory ARGB8888 surface
+	};
+
+	/* Timing of the most recent frame run by Window::Run */
+	struct FrameTiming {
+		double frame_seconds;  // time between the starts of the last two frames
+		double work_seconds;  // time spent on events, updates and painting
+		double average_frame_seconds;  // exponentially smoothed frame_seconds
+		double average_fps;  // 1 / average_frame_seconds
+		unsigned updates;  // Update calls made during the frame
+		bool painted;  // whether the frame was painted
+		unsigned long frames;  // frames run since Run was called
+	};
+
+	/* Quantities FrameProfiler records for every frame */
+	enum class FrameMetric {
+		kEventSeconds,  // polling and dispatching events
+		kUpdateSeconds,  // Update calls
+		kPrePaintSeconds,
+		kPaintSeconds,
+		kPostPaintSeconds,  // PostPaint without the present, the object loop of an ObjectWindow
+		kPresentSeconds,  // SDL_RenderPresent
+		kWorkSeconds,  // everything above, including untimed work in between
+		kDrawCalls,
+		kStateChanges,
+		kObjectsPainted,
+		kEventsHandled,
+		kCount
+	};
+
+	/* One frame's values, indexed by FrameMetric */
+	struct FrameSample {
+		double values[(int)FrameMetric::kCount];
+	};
+
+	/* Statistics of one metric over the profiler's history */
+	struct MetricSummary {
+		double min;
+		double average;
+		double p99;
+		double max;
+	};
+
+	/*!
+	Records per-frame phase times and counters.  Values are added to the
+	current frame as it runs and EndFrame() moves the frame into a rolling
+	history of the last kHistoryFrames frames, optionally appending it to
+	a CSV file as well.
+	*/
+	class FrameProfiler {
+	private:
+		vector<FrameSample> history_;  // ring buffer, oldest at next_ once full
+		size_t next_;
+		unsigned long frames_;
+		FrameSample current_;
+		std::unique_ptr<FILE, int(*)(FILE*)> dump_;
+
+	public:
+		/* Frames kept for the statistics */
+		static const size_t kHistoryFrames = 300;
+
+		//TODO: add docs
+		FrameProfiler();
+
+		/*!
+		Adds value to metric in the current frame.
+		*/
+		void Add(FrameMetric metric, double value);
+
+		/*!
+		Returns the value metric has accumulated so far in the current frame.
+		*/
+		double Current(FrameMetric metric) const;
+
+		/*!
+		Finishes the current frame: stores it in the history, writes it to
+		the dump file if one is open and starts an empty frame.
+		*/
+		void EndFrame();
+
+		/*!
+		Returns min, average, 99th percentile and max of metric over the
+		frames in the history, or all zeroes if there are none.
+		*/
+		MetricSummary Summarize(FrameMetric metric) const;
+
+		/*!
+		Returns the number of frames in the history.
+		*/
+		size_t Size() const;
+
+		/*!
+		Returns a frame from the history, 0 being the oldest.
+		*/
+		const FrameSample& At(size_t index) const;
+
+		/*!
+		Returns the number of frames ended since the profiler was created
+		or reset.
+		*/
+		unsigned long GetFrameCount() const;
+
+		/*!
+		Forgets the history and the current frame.
+		*/
+		void Reset();
+
+		/*!
+		Starts writing every finished frame to path as a line of CSV, after
+		a header naming the metrics.  Returns false if the file cannot be
+		opened.  An empty path stops dumping.
+		*/
+		bool SetDumpFile(const string& path);
+
+		/*!
+		Returns a short name for metric, as used in the dump header.
+		*/
+		static const char* MetricName(FrameMetric metric);
+	};
+
+	class Window {
+	protected:
+		SDL_Window* window_;
+		SDL_Renderer* renderer_;
+		SDL_Surface* surface_;  // offscreen framebuffer, nullptr when shown
+		int width_;
+		int height_;
+		Color background_color_;
+		bool invalid_;  // calling this invalid to match up with what most graphics libraries call it
+		bool running_;
+		vector<SDL_Rect> spans_;  // scratch buffer reused by the filled shape rasterizers
+		vector<SDL_Point> points_;  // pending points, all in draw_color_
+		Color draw_color_;  // color last handed to SDL_SetRenderDrawColor
+		RenderCounters counters_;  // counters for the frame being painted
+		RenderCounters frame_counters_;  // counters for the last finished frame
+		ShapeCache shape_cache_;
+		int target_fps_;  // 0 runs frames back to back
+		double fixed_timestep_;  // 0 passes the measured frame time to Update
+		double accumulator_;  // time not yet consumed by fixed updates
+		bool idle_wait_;
+		FrameTiming timing_;
+		FrameProfiler profiler_;
+		bool profiler_overlay_;
+		RenderBackend backend_;
+		SoftwareRasterizer raster_;  // the frame being drawn, with the software backend
+		SDL_Texture* raster_texture_;  // streaming texture raster_ is uploaded through
+		bool pipelined_;  // Run updates on a simulation thread
+
+		/* What the main thread shares with the simulation thread while a
+		*  pipelined Run is running */
+		struct Pipeline {
+			std::mutex mutex;
+			vector<SDL_Event> events;  // waiting for the simulation thread, guarded by mutex
+			std::atomic<bool> running;
+			std::atomic<unsigned> updates;  // made since the main thread last took them
+			std::atomic<Uint64> update_ticks;  // performance counter ticks spent on them
+		};
+		std::unique_ptr<Pipeline> pipeline_;  // set while a pipelined Run is running
+		const GlyphAtlas* font_;  // what DrawString and Text draw with
+		SDL_Texture* font_texture_;  // font_ uploaded for the renderer, made on first use
+		std::unordered_map<string, vector<GlyphQuad>> layouts_;  // DrawString's, at scale 1
+		vector<GlyphQuad> glyphs_;  // scratch buffer for DrawString
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+		vector<SDL_Vertex> quad_vertices_;  // scratch buffers for SubmitGlyphs and SubmitSprites
+		vector<int> quad_indices_;
+#endif
+		SpriteAtlas sprites_;
+		vector<SpriteQuad> sprite_batch_;  // scratch buffer for DrawCommands
+		InputState input_;
+		vector<Event> events_;  // the frame's events, polled and waiting for DeliverEvents
+		std::unique_ptr<FrameRecorder> recorder_;  // set once recording has been started
+		InputRecorder input_log_;  // open while input is being recorded
+
+		/*!
+		Reads the finished frame into the recorder, before the profiler
+		overlay is drawn.  Called by PostPaint while recording.
+		*/
+		void CaptureFrame();
+
+		/*!
+		Clears the frame to color.
+		*/
+		void ClearFrame(Color color);
+
+		/*!
+		Draws the last frames of the profiler as stacked bars, one color
+		per phase, in the top left corner.  What it draws is not counted
+		in the frame's counters.
+		*/
+		void DrawProfilerOverlay();
+
+		/*!
+		Advances the window by elapsed seconds: one Advance, or as many
+		fixed ones as the accumulated time covers.  Returns the number of
+		updates made.
+		*/
+		unsigned AdvanceTime(double elapsed);
+
+		/*!
+		Takes one update of dt seconds.  The default calls Update(dt).
+		*/
+		virtual void Advance(double dt);
+
+		/*!
+		Routes one SDL event to the matching handler.
+		*/
+		void DispatchEvent(const SDL_Event& event);
+
+		/*!
+		Appends every event SDL has queued to events_.
+		*/
+		void PollEvents();
+
+		/*!
+		Merges each run of consecutive mouse motion events in events into
+		one, with the last position and the summed relative motion, so a
+		frame costs one MouseMoved per run however fast the mouse reports.
+		*/
+		static void CoalesceMotion(vector<Event>& events);
+
+		/*!
+		Starts a new frame of input with events: coalesces them, folds them
+		into the input state, stops Run on SDL_QUIT and hands them to
+		HandleEvents.  Called once a frame, with or without events.
+		*/
+		void DeliverEvents(vector<Event>& events);
+
+		/*!
+		Sleeps until the next frame is due.  With nothing invalid and idle
+		waiting enabled it instead blocks until an event arrives, the next
+		fixed update is due or kIdleTimeoutMs passes.
+		*/
+		void WaitForNextFrame(Uint64& next_frame);
+
+		/*!
+		Records the timing of a frame of Run that started at frame_start,
+		elapsed seconds after the one before it, and ends its profiler
+		frame.
+		*/
+		void EndRunFrame(Uint64 frame_start, double elapsed, unsigned updates, bool painted);
+
+		/*!
+		Run with Update on a simulation thread.  The main thread polls
+		events and queues them for the simulation thread, and paints
+		whenever AcquireSnapshot() reports a new snapshot, so every SDL
+		call stays on the main thread and a slow Update never holds back
+		a frame.
+		*/
+		void RunPipelined();
+
+		/*!
+		The simulation thread of a pipelined Run: dispatches the queued
+		events, advances time and publishes a snapshot after any change,
+		until Quit or the window is closed.
+		*/
+		void Simulate();
+
+		/*!
+		Called on the simulation thread of a pipelined Run after events
+		or updates, to publish the scene they produced for the main thread
+		to paint.  The default does nothing.
+		*/
+		virtual void PublishSnapshot();
+
+		/*!
+		Called on the main thread of a pipelined Run to take the latest
+		published snapshot for painting.  Returns false if there is none
+		newer than the last one; the default always does.
+		*/
+		virtual bool AcquireSnapshot();
+
+		/*!
+		Makes color the renderer's draw color.  Pending points are flushed
+		first if they were queued in a different color.
+		*/
+		void SetDrawColor(Color color);
+
+		/*!
+		Submits all pending points with a single SDL_RenderDrawPoints call.
+		Every primitive that is not a point calls this before drawing so
+		that the batched points keep their place in the drawing order.
+		*/
+		void FlushPoints();
+
+		/*!
+		Fills rects in the current draw color with whichever backend is
+		active, as one draw call.
+		*/
+		void SubmitFillRects(const SDL_Rect* rects, size_t count);
+
+		/*!
+		Outlines rects in the current draw color, as one draw call.
+		*/
+		void SubmitDrawRects(const SDL_Rect* rects, size_t count);
+
+		/*!
+		Draws lines joining count points in the current draw color, as
+		one draw call.
+		*/
+		void SubmitDrawLines(const SDL_Point* points, size_t count);
+
+		/*!
+		Draws glyphs from the font in the current draw color, as one
+		SDL_RenderGeometry call, or one SDL_RenderCopy per glyph before
+		SDL 2.0.18.
+		*/
+		void SubmitGlyphs(const GlyphQuad* glyphs, size_t count);
+
+		/*!
+		Returns the font's texture, white glyphs on transparent black,
+		making it on first use.  Returns nullptr if it cannot be made.
+		*/
+		SDL_Texture* GetFontTexture();
+
+		/*!
+		Draws sprites from the sprite atlas with their tints, as one
+		SDL_RenderGeometry call per run of one page, or before SDL 2.0.18
+		one SDL_RenderCopy per sprite.
+		*/
+		void SubmitSprites(const SpriteQuad* sprites, size_t count);
+
+		/*!
+		Sets the clip rect of the active backend; nullptr disables it.
+		*/
+		void SetClipRect(const SDL_Rect* rect);
+
+		/*!
+		Copies the software framebuffer to the renderer through a
+		streaming texture.  Called by PostPaint before presenting.
+		*/
+		void UploadRaster();
+
+		/*!
+		Appends the rows of a filled ellipse centered at (x, y) to spans_.
+		Each row's extent is computed once and rows of equal width are
+		merged, so at most 2 * radius_y + 1 rects are produced.
+		*/
+		void AppendEllipseSpans(int x, int y, int radius_x, int radius_y);
+
+		/*!
+		Appends the rim of a circle centered at (x, y) to points_.
+		*/
+		void AppendCirclePoints(int x, int y, int radius);
+
+		/*!
+		Returns a texture holding the circle, rasterizing it into the shape
+		cache on a miss.  Returns nullptr if the circle does not fit in the
+		cache, in which case it should be drawn directly.
+		*/
+		SDL_Texture* GetCircleTexture(Color color, int radius, bool filled);
+
+	public:
+		/*!
+		Creates a window with title, dimensions, and background color.
+		*/
+		Window(const string& title, int width, int height, const Color& background);
+
+		/*!
+		Creates a window in the given mode.  An offscreen window needs no
+		display or GPU; drive it with Step() or RenderFrame() and read the
+		result back with GetPixels() or ReadPixels().
+		*/
+		Window(const string& title, int width, int height, const Color& background,
+			WindowMode mode);
+
+		// Objects and callbacks keep pointers to their window
+		Window(const Window&) = delete;
+		Window& operator=(const Window&) = delete;
+		Window(Window&&) = delete;
+		Window& operator=(Window&&) = delete;
+
+		/*!
+		Destroys the window's textures, renderer and framebuffer, and the
+		SDL window when shown.
+		*/
+		virtual ~Window();
+
+		/*!
+		Sets the background color of the window.
+		*/
+		void SetBackgroundColor(const Color& color);
+
+		/*!
+		Receives the frame's events, after motion has been coalesced and
+		the input state updated.  The default routes each to KeyPressed,
+		MouseMoved and the other handlers; override it to take a frame's
+		input in one batch instead.
+		*/
+		virtual void HandleEvents(Span<const Event> events);
+
+		/*!
+		Returns the keyboard and mouse state as of the frame's events.
+		*/
+		const InputState& GetInput() const;
+
+		/*!
+		Key press event handler. Override this to handle key presses.
+		@param key 
+		*/
+		virtual void KeyPressed(const KeyboardEvent & event);
+
+		//TODO: add docs
+		virtual void MouseMoved(const MouseMotionEvent & event);
+
+		//TODO: add docs
+		virtual void MousePressed(const MouseButtonEvent& event);
+
+		//TODO: add docs
+		virtual void MouseReleased(const MouseButtonEvent& event);
+
+		//TODO: add docs
+		virtual void MouseEntered();
+
+		//TODO: add docs
+		virtual void MouseExited();
+
+		//TODO: add docs
+		virtual void PrePaint();
+
+		/*!
+		Must override. Handles drawing objects, called when the window needs to be repainted.
+		*/
+		virtual void Paint() = 0;
+
+		//TODO: add docs
+		virtual void PostPaint();
+
+		//TODO: add docs
+		void PaintAll();
+
+		//TODO: add docs
+		void Repaint();
+
+		//TODO: add docs
+		void DrawPoint(Color color, int x, int y);
+
+		//TODO: add docs
+		void DrawPoint(int x, int y);
+
+		/*!
+		Draws count points in the given color.  Points are queued and
+		submitted together with every other point drawn in the same color
+		until a different color or another primitive is drawn.
+		*/
+		void DrawPoints(Color color, const SDL_Point* points, size_t count);
+
+		//TODO: add docs
+		void DrawRectangle(Color color, const SDL_Rect& rect);
+
+		//TODO: add docs
+		void DrawFilledRectangle(Color color, const SDL_Rect& rect);
+
+		void EightOcts(int edge_x, int edge_y, int center_x, int center_y);
+
+		//TODO: add docs
+		void DrawCircle(Color, int x, int y, int radius);
+
+		/*!
+		Draws a filled circle centered at (x, y).  The circle is rasterized
+		as horizontal spans submitted with a single SDL_RenderFillRects call.
+		*/
+		void DrawFilledCircle(Color color, int x, int y, int radius);
+
+		/*!
+		Draws a filled axis-aligned ellipse centered at (x, y), using the same
+		span rasterizer as DrawFilledCircle.
+		*/
+		void DrawFilledEllipse(Color color, int x, int y, int radius_x, int radius_y);
+
+		//TODO: add docs
+		void DrawLine(Color color, int x1, int y1, int x2, int y2);
+
+		/*!
+		Draws lines joining count points, in order, with a single
+		SDL_RenderDrawLines call.  A closed outline repeats its first
+		point at the end.
+		*/
+		void DrawPolyline(Color color, const SDL_Point* points, size_t count);
+
+		/*!
+		Draws text with its top left corner at (x, y), each font pixel
+		scale pixels square, as one batched submission.  Layouts are
+		cached by string, so redrawing a label that has not changed costs
+		little more than the submission.
+		*/
+		void DrawString(Color color, int x, int y, const string& text, int scale = 1);
+
+		/*!
+		Sets the font DrawString and Text objects use.  In an ObjectWindow
+		the Text objects already in the window are laid out again.  The
+		atlas must outlive the window.
+		*/
+		virtual void SetFont(const GlyphAtlas& font);
+
+		//TODO: add docs
+		const GlyphAtlas& GetFont() const;
+
+		/*!
+		Loads a BMP file into the window's sprite atlas.  Returns an image
+		with no page, which draws nothing, if the file cannot be read.
+		*/
+		SpriteImage LoadSprite(const string& path);
+
+		/*!
+		Copies width by height ARGB8888 pixels into the window's sprite
+		atlas.
+		*/
+		SpriteImage AddSprite(const Uint32* pixels, int width, int height);
+
+		//TODO: add docs
+		const SpriteAtlas& GetSpriteAtlas() const;
+
+		/*!
+		Draws image scaled to dest, its pixels modulated by tint.
+		*/
+		void DrawSprite(const SpriteImage& image, const SDL_Rect& dest,
+			Color tint = Color::kWhite);
+
+		/*!
+		Draws every batch of a sorted DrawList, with one color change and
+		one SDL submission per batch.
+		*/
+		void DrawCommands(const DrawList& list);
+
+		/*!
+		Returns the draw call, state change and object counts of the last
+		frame painted by PaintAll.
+		*/
+		const RenderCounters& GetFrameCounters() const;
+
+		/*!
+		Returns the cache of rasterized shapes used when drawing recorded
+		circles.  Set its budget to zero to draw circles directly.
+		*/
+		ShapeCache& GetShapeCache();
+
+		/*!
+		Called by Update(double) once per step.  Override this or
+		Update(double), not both.
+		*/
+		virtual void Update();
+
+		/*!
+		Advances the window by dt seconds.  Called once per frame with the
+		measured frame time, or repeatedly with the fixed timestep if one
+		is set.  The default calls Update().
+		*/
+		virtual void Update(double dt);
+
+		/*!
+		Runs the main loop, which handles rendering, events, and updates.
+		*/
+		void Run();
+
+		/*!
+		Runs one frame without waiting: dispatches pending events, advances
+		the window by dt seconds as Run would and paints if anything is
+		invalid.  Returns whether the frame was painted.
+		*/
+		bool Step(double dt);
+
+		/*!
+		Paints a frame now, whether or not anything is invalid.
+		*/
+		void RenderFrame();
+
+		/*!
+		Returns the offscreen framebuffer, GetHeight() rows of GetPitch()
+		bytes of ARGB8888 pixels, or nullptr for a shown window.
+		*/
+		const Uint32* GetPixels() const;
+
+		/*!
+		Returns the length of a framebuffer row in bytes.
+		*/
+		int GetPitch() const;
+
+		/*!
+		Copies the current frame into pixels as tightly packed ARGB8888,
+		in either mode.  Returns false if the renderer cannot read back.
+		*/
+		bool ReadPixels(vector<Uint32>& pixels);
+
+		//TODO: add docs
+		int GetWidth() const;
+
+		//TODO: add docs
+		int GetHeight() const;
+
+		/*!
+		Chooses where primitives are rasterized.  With kSoftware every
+		primitive draws into a CPU framebuffer that is uploaded once per
+		frame, and colors with alpha blend the same way on every renderer.
+		Either way alpha is blended source-over.  Repaints the window.
+		*/
+		virtual void SetRenderBackend(RenderBackend backend);
+
+		//TODO: add docs
+		RenderBackend GetRenderBackend() const;
+
+		/*!
+		Returns the framebuffer of the software backend.
+		*/
+		const SoftwareRasterizer& GetRasterizer() const;
+
+		/*!
+		Caps Run at fps frames per second by sleeping out the rest of each
+		frame.  0, the default, runs frames back to back.
+		*/
+		void SetFrameRate(int fps);
+
+		/*!
+		Enables or disables waiting for the display's vertical sync in
+		SDL_RenderPresent.  Returns false if the renderer cannot change it,
+		which is always the case before SDL 2.0.18.
+		*/
+		bool SetVSync(bool enabled);
+
+		/*!
+		Makes Run call Update(seconds) at a fixed rate, independent of the
+		frame rate, by accumulating elapsed time.  0, the default, calls
+		Update once per frame with the measured frame time.
+		*/
+		void SetFixedTimestep(double seconds);
+
+		/*!
+		When enabled, Run blocks waiting for events whenever nothing needs
+		repainting instead of spinning, so an idle window uses no CPU.
+		Without a fixed timestep Update then runs only on events and every
+		kIdleTimeoutMs, so windows that animate from Update without
+		invalidating should leave it off.  Disabled by default.
+		*/
+		void SetIdleWait(bool enabled);
+
+		/*!
+		Returns the timing of the last frame run by Run.
+		*/
+		const FrameTiming& GetFrameTiming() const;
+
+		/*!
+		Returns the profiler holding per-phase times and counters of the
+		frames run by Run, Step and RenderFrame.
+		*/
+		FrameProfiler& GetProfiler();
+
+		/*!
+		Shows or hides the profiler overlay, drawn over everything Paint
+		and PostPaint drew just before the frame is presented.
+		*/
+		void SetProfilerOverlay(bool enabled);
+
+		/* Longest wait, in milliseconds, of an idle window between updates */
+		static const int kIdleTimeoutMs = 100;
+
+		/* Longest frame time fed to the fixed timestep accumulator, so a stall
+		*  does not turn into a burst of catch-up updates */
+		static constexpr double kMaxFrameSeconds = 0.25;
+
+		/* DrawString layouts kept before the cache is emptied */
+		static const size_t kMaxCachedLayouts = 256;
+
+		/*!
+		Starts logging the input of every frame run by Run or Step to path,
+		and seeds rand() with a seed the log keeps, so ReplayInput can play
+		the session again.  Returns false if the log cannot be opened.
+		*/
+		bool StartInputRecording(const string& path);
+
+		/*!
+		Closes the input log.
+		*/
+		void StopInputRecording();
+
+		/*!
+		Plays back an input log: seeds rand() as the recording did, then
+		for every logged frame delivers its events through HandleEvents,
+		advances time by the logged frame time, or by dt if it is positive,
+		and paints if anything is invalid, without waiting for the clock or
+		polling live events.  The window's profiler gets a frame per logged
+		frame, so on identical input SetDumpFile records comparable frame
+		timings.  Use an offscreen window to replay headless.  Stops at the
+		end of the log or on Quit, and returns false if the log cannot be
+		read.
+		*/
+		bool ReplayInput(const string& path, double dt = 0.0);
+
+		/*!
+		Starts recording every frame PostPaint presents to path, on a
+		writer thread; see FrameRecorder::Start.  kY4m streams are stamped
+		with the frame rate set by SetFrameRate, or 60 without one.
+		Returns false if the recording cannot be started.
+		*/
+		bool StartRecording(const string& path, CaptureFormat format,
+			size_t buffers = FrameRecorder::kDefaultBuffers,
+			CaptureDropPolicy policy = CaptureDropPolicy::kDropOldest);
+
+		/*!
+		Stops recording once the writer has caught up.
+		*/
+		void StopRecording();
+
+		/*!
+		Returns the counts of the current or last recording, all zero if
+		there has been none.
+		*/
+		CaptureStats GetRecordingStats() const;
+
+		/*!
+		Closes the window.  Safe to call from Update in a pipelined Run.
+		*/
+		void Quit();
+	};
+
+	/* forward declarations */
+	class ObjectWindow;
+	class ObjectPool;
+
+	/*!
+	Refers to an object created by ObjectWindow::Create.  A handle holds
+	the object's pool slot and the generation of the slot when the object
+	was created; destroying the object bumps the generation, so the window
+	resolves stale handles to nullptr instead of a dangling pointer.  A
+	default constructed handle is null.
+	*/
+	template <typename T>
+	class Handle {
+		template <typename U> friend class Handle;
+		friend class ObjectPool;
+
+	private:
+		Uint32 index_;
+		Uint32 generation_;  // 0 only in null handles
+
+		Handle(Uint32 index, Uint32 generation);
+
+	public:
+		//TODO: add docs
+		Handle();
+
+		/*!
+		Converts a handle to a derived type into a handle to its base.
+		*/
+		template <typename U>
+		Handle(const Handle<U>& other);
+
+		//TODO: add docs
+		bool IsNull() const;
+
+		//TODO: add docs
+		bool operator==(const Handle& other) const;
+
+		//TODO: add docs
+		bool operator!=(const Handle& other) const;
+	};
+
+	class GraphicalObject {
+		friend class ObjectWindow;
+		friend class SpatialGrid;
+		friend struct ShapeArrays;
+		friend struct BodyArrays;
+		friend class ObjectPool;
+
+	protected:
+		ObjectWindow* window_;
+		SDL_Rect rect_;
+		Color color_;
+		bool filled_;
+
+		/*!
+		Tells the owning window that the object was mutated.  old_rect is
+		the object's rect before the change.  Every setter calls this.
+		*/
+		void Changed(const SDL_Rect& old_rect);
+
+		/*!
+		Called when the object is added to its window and whenever the
+		window's font changes.  Does nothing by default.
+		*/
+		virtual void FontChanged();
+
+	public:
+		/* Unique identifier for object */
+		const unsigned id_;
+
+		//TODO: add docs
+		GraphicalObject(ObjectWindow* window, Color color);
+
+		//TODO: add docs
+		GraphicalObject(ObjectWindow* window, Color color, bool filled);
+
+		//TODO: add docs
+		GraphicalObject(ObjectWindow* window, Color color, int x, int y);
+
+		//TODO: add docs
+		virtual ~GraphicalObject();
+
+		/*!
+		Records the object's primitives into the window's DrawList.  The
+		built-in shapes never draw directly; custom objects may draw
+		immediately, but are then painted before every recorded primitive.
+		*/
+		virtual void Paint() = 0;
+
+		//TODO: add docs
+		int GetPosX();
+
+		//TODO: add docs
+		int GetPosY();
+
+		//TODO: add docs
+		void SetPosX(int x);
+
+		//TODO: add docs
+		void SetPosY(int y);
+
+		//TODO: add docs
+		int GetWidth();
+
+		//TODO: add docs
+		int GetHeight();
+
+		//TODO: add docs
+		void SetWidth(int width);
+
+		//TODO: add docs
+		void SetHeight(int height);
+
+		//TODO: add docs
+		void SetFilled(bool filled);
+
+		//TODO: add docs
+		bool Hit(int x, int y);
+
+		//TODO: add docs
+		bool Collision(GraphicalObject* obj);
+
+		/*!
+		Gives the object a body moving at (vx, vy) pixels per second, or
+		changes its velocity.  The window moves bodies before every Update,
+		keeping their positions in floats, and stops them where they would
+		pass through another object.  Ignored unless the object is in its
+		window; Remove takes the body away.
+		*/
+		void SetVelocity(float vx, float vy);
+
+		/*!
+		Returns the horizontal velocity of the body, 0 without one.
+		*/
+		float GetVelocityX();
+
+		//TODO: add docs
+		float GetVelocityY();
+
+		//TODO: add docs
+		bool HasBody();
+
+		/*!
+		Takes the body away, leaving the object where it is.
+		*/
+		void RemoveBody();
+
+		/*!
+		Returns the x position of the body, which GetPosX rounds down, or
+		GetPosX without a body.
+		*/
+		float GetExactPosX();
+
+		//TODO: add docs
+		float GetExactPosY();
+
+		/*!
+		Moves the object to (x, y), keeping the fractions if it has a body.
+		*/
+		void SetExactPos(float x, float y);
+
+	private:
+		static unsigned id_source_;
+		bool in_window_;  // true between ObjectWindow::Add and Remove
+		unsigned order_;  // draw order, assigned by ObjectWindow::Add
+		unsigned query_stamp_;  // last SpatialGrid query that visited the object
+		int shape_;  // ShapeKind of the arrays holding a copy of the object, in array storage
+		size_t slot_;  // index of that copy
+		size_t object_index_;  // position in ObjectWindow::objects_
+		Uint32 pool_slot_;  // ObjectPool slot, kNoPoolSlot if not created by a pool
+		Uint32 body_;  // index in ObjectWindow's BodyArrays, kNoBody without a body
+		unsigned layer_;  // index in ObjectWindow's layers, 0 for the default layer
+
+		static const Uint32 kNoPoolSlot = 0xFFFFFFFF;
+		static const Uint32 kNoBody = 0xFFFFFFFF;
+	};
+
+	class Point : public GraphicalObject {
+	public:
+		//TODO: add docs
+		Point(ObjectWindow* window, Color color, int x, int y);
+
+		//TODO: add docs
+		void Paint() override;
+	};
+
+	class Rectangle : public GraphicalObject {
+	public:
+		//TODO: add docs
+		Rectangle(ObjectWindow* window, Color color, int x, int y, int width,
+			int height);
+
+		//TODO: add docs
+		Rectangle(ObjectWindow* window, Color color, int x, int y, int width,
+			int height, bool filled);
+
+		//TODO: add docs
+		void Paint() override;
+	};
+
+	class Circle : public GraphicalObject {
+	public:
+		//TODO: add docs
+		Circle(ObjectWindow* window, Color color, int x, int y, int radius);
+
+		//TODO: add docs
+		Circle(ObjectWindow* window, Color color, int x, int y, int radius, bool filled);
+
+		//TODO: add docs
+		void SetRadius(int radius);
+
+		//TODO: add docs
+		void Paint() override;
+	};
+
+	/*!
+	A Catmull-Rom spline through a list of control points, drawn as a
+	polyline.  The curve is tessellated adaptively, finer where it bends,
+	and the vertices are cached until the control points change; moving
+	the spline with SetPosX and SetPosY reuses them.  The rect is the
+	bounds of the curve, so width and height are set by the control
+	points.
+	*/
+	class Spline : public GraphicalObject {
+	private:
+		vector<SDL_Point> control_points_;  // relative to the rect's top left corner
+		vector<SDL_Point> vertices_;  // tessellated curve, relative to the rect's top left corner
+
+		/*!
+		Tessellates the curve through control_points_ into vertices_ and
+		moves the rect to the curve's bounds, keeping both relative to it.
+		*/
+		void Tessellate();
+
+	public:
+		/* Distance in pixels the tessellated curve may stray from the true one */
+		static constexpr double kTolerance = 0.5;
+
+		/* Limit on the halvings of one curve segment */
+		static const int kMaxDepth = 8;
+
+		/*!
+		Creates a spline through count control points, in window
+		coordinates.
+		*/
+		Spline(ObjectWindow* window, Color color, const SDL_Point* points, size_t count);
+
+		//TODO: add docs
+		size_t GetControlPointCount() const;
+
+		/*!
+		Returns control point i in window coordinates.
+		*/
+		SDL_Point GetControlPoint(size_t i) const;
+
+		/*!
+		Moves control point i to (x, y), in window coordinates.
+		*/
+		void SetControlPoint(size_t i, int x, int y);
+
+		/*!
+		Replaces every control point, tessellating once.
+		*/
+		void SetControlPoints(const SDL_Point* points, size_t count);
+
+		//TODO: add docs
+		void AddControlPoint(int x, int y);
+
+		/*!
+		Returns the cached vertices of the curve, relative to its rect.
+		*/
+		const vector<SDL_Point>& GetVertices() const;
+
+		//TODO: add docs
+		void Paint() override;
+	};
+
+	/*!
+	A string drawn in the window's font.  The layout is made when the text
+	or scale is set and cached, so a label that does not change, or is set
+	to the same text again, costs only its recording.  The rect is the
+	bounds of the text.
+	*/
+	class Text : public GraphicalObject {
+	private:
+		string text_;
+		int scale_;
+		vector<GlyphQuad> glyphs_;  // relative to the rect's top left corner
+		const GlyphAtlas* font_;  // the font glyphs_ was laid out in
+
+		/* Lays the text out again and resizes the rect to fit it */
+		void Layout();
+
+		/* Lays the text out again if the window's font is not font_ */
+		void FontChanged() override;
+
+	public:
+		//TODO: add docs
+		Text(ObjectWindow* window, Color color, int x, int y, const string& text, int scale = 1);
+
+		//TODO: add docs
+		const string& GetText() const;
+
+		/*!
+		Sets the text, laying it out only if it changed.
+		*/
+		void SetText(const string& text);
+
+		//TODO: add docs
+		int GetScale() const;
+
+		//TODO: add docs
+		void SetScale(int scale);
+
+		//TODO: add docs
+		void Paint() override;
+	};
+
+	/*!
+	An image from the window's sprite atlas, drawn stretched over the
+	object's rect and modulated by its color.  Sprites of one atlas page
+	are batched together whatever their tints.
+	*/
+	class Sprite : public GraphicalObject {
+	private:
+		SpriteImage image_;
+
+	public:
+		/*!
+		Creates a sprite at (x, y) the size of image, untinted.
+		*/
+		Sprite(ObjectWindow* window, const SpriteImage& image, int x, int y);
+
+		//TODO: add docs
+		Sprite(ObjectWindow* window, const SpriteImage& image, int x, int y, Color tint);
+
+		//TODO: add docs
+		const SpriteImage& GetImage() const;
+
+		/*!
+		Changes the image, keeping the sprite's size.
+		*/
+		void SetImage(const SpriteImage& image);
+
+		//TODO: add docs
+		Color GetTint() const;
+
+		//TODO: add docs
+		void SetTint(Color tint);
+
+		//TODO: add docs
+		void Paint() override;
+	};
+
+	/*!
+	A uniform grid over object bounds, used by ObjectWindow to answer point
+	and rect queries without scanning every object.  Objects are bucketed
+	into every cell their (inclusive) bounds touch; objects that would
+	cover more than kMaxCellsPerObject cells are kept in a separate list
+	that every query checks.
+	*/
+	class SpatialGrid {
+	private:
+		int cell_size_;
+		std::unordered_map<Uint64, vector<GraphicalObject*>> cells_;
+		vector<GraphicalObject*> oversized_;
+		unsigned stamp_;
+		SDL_Rect extent_;  // cells inserted into since Clear, empty when w is 0
+
+		void CellRange(const SDL_Rect& rect, int& x0, int& y0, int& x1, int& y1) const;
+
+	public:
+		static const int kDefaultCellSize = 64;
+		static const int kMaxCellsPerObject = 256;
+
+		//TODO: add docs
+		explicit SpatialGrid(int cell_size = kDefaultCellSize);
+
+		//TODO: add docs
+		int GetCellSize() const;
+
+		//TODO: add docs
+		void Insert(GraphicalObject* obj, const SDL_Rect& rect);
+
+		/*!
+		Removes obj, which must have been inserted with rect.
+		*/
+		void Remove(GraphicalObject* obj, const SDL_Rect& rect);
+
+		/*!
+		Moves obj from old_rect to new_rect.  Cheap when both rects cover
+		the same cells, which is the common case for small moves.
+		*/
+		void Move(GraphicalObject* obj, const SDL_Rect& old_rect, const SDL_Rect& new_rect);
+
+		/*!
+		Appends every object whose cells touch area to results, each at most
+		once.  Results are candidates; callers do the exact test.
+		*/
+		void Query(const SDL_Rect& area, vector<GraphicalObject*>& results);
+
+		/*!
+		Returns a rect holding every cell an object has been inserted into
+		since the last Clear, or an empty rect.  It never shrinks, so it
+		bounds the objects rather than fitting them.
+		*/
+		SDL_Rect GetExtent() const;
+
+		//TODO: add docs
+		void Clear();
+	};
+
+	/* How ObjectWindow stores the objects added to it */
+	enum class ObjectStorage {
+		kObjects,  // painted through the objects' virtual Paint
+		kArrays  // copies in per-shape arrays, painted by non-virtual loops
+	};
+
+	/* How often ObjectWindow paints the objects of a layer */
+	enum class LayerMode {
+		kDynamic,  // every frame
+		kStatic  // once into a cached texture, again only after one of them changes
+	};
+
+	/* The arrays an object is copied into in array storage.  Objects of
+	*  exactly Point, Rectangle or Circle type are painted from their
+	*  arrays; any other type is kCustom and still painted through Paint. */
+	enum class ShapeKind {
+		kPoint,
+		kRectangle,
+		kCircle,
+		kCustom,
+		kCount
+	};
+
+	/*!
+	Bounds, colors and fill of one kind of shape, one element per object,
+	kept in draw order.  Every setter of an object writes its new state
+	through to its element, so painting and hit testing can run over the
+	arrays without touching the objects.
+	*/
+	struct ShapeArrays {
+		vector<int> x;
+		vector<int> y;
+		vector<int> w;
+		vector<int> h;
+		vector<Color> color;
+		vector<Uint8> filled;
+		vector<unsigned> order;
+		vector<unsigned> layer;
+		vector<GraphicalObject*> object;  // nullptr marks an erased element
+		size_t erased;  // erased elements not yet compacted away
+
+		//TODO: add docs
+		ShapeArrays();
+
+		/*!
+		Appends obj, which must come after every object already stored.
+		*/
+		void Append(GraphicalObject* obj, ShapeKind kind);
+
+		/*!
+		Copies the object's current state into its element.
+		*/
+		void Store(const GraphicalObject* obj);
+
+		/*!
+		Erases the element at slot in constant time by marking it, and
+		compacts the arrays once erased elements outnumber live ones.
+		*/
+		void Erase(size_t slot);
+
+		/*!
+		Drops the erased elements, keeping the rest in draw order.
+		*/
+		void Compact();
+
+		//TODO: add docs
+		void Clear();
+
+		//TODO: add docs
+		size_t Size() const;
+	};
+
+	/*!
+	Positions and velocities of the objects that have a body, one element
+	per body, in floats so that slow bodies still move.  Kept apart from
+	the objects so a whole step is integrated in one vectorized pass.
+	Element order is arbitrary; erasing moves the last body into the hole.
+	*/
+	struct BodyArrays {
+		vector<float> x;
+		vector<float> y;
+		vector<float> vx;  // pixels per second
+		vector<float> vy;
+		vector<GraphicalObject*> object;
+
+		/*!
+		Gives obj a body at its current position, at rest.
+		*/
+		void Append(GraphicalObject* obj);
+
+		/*!
+		Erases the body at index in constant time.
+		*/
+		void Erase(size_t index);
+
+		/*!
+		Moves every body by its velocity times dt.
+		*/
+		void Integrate(float dt);
+
+		//TODO: add docs
+		void Clear();
+
+		//TODO: add docs
+		size_t Size() const;
+	};
+
+	/* A body running into another object during a step */
+	struct Contact {
+		GraphicalObject* body;  // nullptr if removed by an earlier callback of the batch
+		GraphicalObject* other;  // which may be a body too; nullptr like body
+		float time;  // fraction of the step at which they touched, 0...1
+		int normal_x;  // face of other that was hit, pointing toward body:
+		int normal_y;  // (-1, 0) is its left face, (0, -1) its top and so on
+	};
+
+	/*!
+	Owns the objects created through ObjectWindow::Create.  Objects of each
+	type are constructed in chunks of kChunkSize, and the memory of
+	destroyed objects is reused by later ones of the same type, so creating
+	and destroying objects does not allocate once a scene has warmed up.
+	Every object still alive is destroyed with the pool.
+	*/
+	class ObjectPool {
+	private:
+		class ArenaBase {
+		public:
+			virtual ~ArenaBase() {}
+			virtual void Destroy(GraphicalObject* obj) = 0;
+		};
+
+		template <typename T>
+		class Arena : public ArenaBase {
+		private:
+			using Storage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+			vector<std::unique_ptr<Storage[]>> chunks_;
+			size_t used_;  // elements handed out from the last chunk
+			vector<void*> free_;
+
+		public:
+			Arena();
+			void* Allocate();
+			void Destroy(GraphicalObject* obj) override;
+		};
+
+		struct Slot {
+			GraphicalObject* object;  // nullptr while the slot is free
+			ArenaBase* arena;
+			Uint32 generation;
+		};
+
+		vector<Slot> slots_;
+		vector<Uint32> free_slots_;
+		std::unordered_map<std::type_index, std::unique_ptr<ArenaBase>> arenas_;
+		size_t size_;
+
+	public:
+		/* Objects constructed per allocation */
+		static const size_t kChunkSize = 256;
+
+		//TODO: add docs
+		ObjectPool();
+
+		ObjectPool(const ObjectPool&) = delete;
+		ObjectPool& operator=(const ObjectPool&) = delete;
+		ObjectPool(ObjectPool&&) = default;
+		ObjectPool& operator=(ObjectPool&&) = delete;
+
+		//TODO: add docs
+		~ObjectPool();
+
+		/*!
+		Constructs a T from args and returns a handle to it.
+		*/
+		template <typename T, typename... Args>
+		Handle<T> Create(Args&&... args);
+
+		/*!
+		Returns the object handle refers to, or nullptr if the handle is
+		null or its object was destroyed.
+		*/
+		template <typename T>
+		T* Get(const Handle<T>& handle) const;
+
+		/*!
+		Returns a handle to obj, or a null handle if obj is not owned by
+		this pool.
+		*/
+		Handle<GraphicalObject> GetHandle(const GraphicalObject* obj) const;
+
+		/*!
+		Destroys the object handle refers to.  Returns false if the handle
+		is stale.
+		*/
+		bool Destroy(const Handle<GraphicalObject>& handle);
+
+		/*!
+		Destroys every object.
+		*/
+		void Clear();
+
+		/*!
+		Returns the number of live objects.
+		*/
+		size_t Size() const;
+	};
+
+	class ObjectWindow : public Window {
+		friend class GraphicalObject;
+
+	protected:
+		vector<GraphicalObject*> objects_;  // in draw order; nullptr marks a removed object
+		size_t removed_objects_;  // nullptr entries in objects_
+		ObjectPool pool_;
+		DrawList draw_list_;
+		bool draw_sorting_;
+		SpatialGrid grid_;
+		unsigned next_order_;
+		vector<GraphicalObject*> sweep_;  // objects sorted by x for ForEachCollisionPair
+		bool sweep_dirty_;
+		vector<GraphicalObject*> candidates_;  // scratch buffer for grid queries
+		bool damage_tracking_;
+		bool full_damage_;
+		vector<SDL_Rect> damage_;  // screen regions to repaint next frame
+		SDL_Texture* canvas_;  // persistent frame the damaged regions are repainted into
+		Color canvas_background_;  // background the canvas was last cleared with
+		ObjectStorage storage_;
+		ShapeArrays shapes_[(int)ShapeKind::kCount];  // array storage, indexed by ShapeKind
+		std::unique_ptr<WorkerPool> workers_;  // set while tiled rendering is on
+		int tile_size_;
+		vector<vector<Uint32>> tile_commands_;  // per tile, indices into the sorted draw list
+		vector<vector<SDL_Rect>> tile_spans_;  // per thread scratch
+		vector<vector<SDL_Point>> tile_points_;  // per thread scratch
+		std::unique_ptr<TripleBuffer<SceneSnapshot>> snapshots_;  // set while pipelined
+		BodyArrays bodies_;
+		std::function<void(Span<const Contact>)> contact_callback_;
+		vector<Contact> contacts_;  // found by the step being taken
+		struct BodyStop {
+			Uint32 body;
+			float time;
+			float x, y;  // where the step started
+		};
+		vector<BodyStop> body_stops_;  // bodies the step cut short, with their contact time
+		Camera camera_;
+		struct Layer {
+			string name;
+			int z;
+			LayerMode mode;
+			SDL_Texture* cache;  // static layers: the layer alone, premultiplied over transparency
+			bool dirty;  // the cache is out of date
+		};
+		vector<Layer> layers_;  // the default layer first
+		vector<unsigned> layer_order_;  // indices into layers_, in z order
+		bool layer_caching_;  // false once the renderer refused a cache
+
+		/*!
+		Returns the screen pixels an object with bounds rect may paint,
+		as seen through the camera.
+		*/
+		SDL_Rect ScreenBounds(const SDL_Rect& rect) const;
+
+		/*!
+		Returns the world rect seen in area, a rect of screen pixels,
+		grown to whole world units.
+		*/
+		SDL_Rect WorldArea(const SDL_Rect& area) const;
+
+		/*!
+		Records the objects of layer that may paint inside area, a rect
+		of screen pixels, in draw order, in world coordinates.  Only the
+		objects the grid finds in view are painted, unless most of the
+		scene is in view, when a pass in draw order is cheaper.  Returns
+		the number of objects painted.
+		*/
+		unsigned RecordLayer(const SDL_Rect& area, unsigned layer);
+
+		/*!
+		Records every layer's objects that may paint inside area, layer
+		by layer in z order, and moves the draw list to the screen.
+		Returns the number of objects painted.
+		*/
+		unsigned RecordVisible(const SDL_Rect& area);
+
+		/*!
+		Returns whether static layers are drawn from cached textures: on
+		the renderer backend, with render targets and premultiplied
+		blending, which needs SDL 2.0.6.
+		*/
+		bool CachesLayers() const;
+
+		/*!
+		Repaints the cache of every static layer that changed, each into
+		its own render target, leaving the render target as it was.
+		*/
+		void UpdateLayerCaches();
+
+		/*!
+		Draws the layers inside area in z order, the static ones with an
+		up to date cache as one copy each, and the objects of the others
+		recorded and drawn between them.  What the draw list already
+		holds goes underneath.
+		*/
+		void DrawLayers(const SDL_Rect& area);
+
+		/*!
+		Marks rect, in screen pixels, as needing a repaint.  Overlapping
+		regions are merged, and past kMaxDamageRects regions or half the
+		window the whole window is repainted instead.
+		*/
+		void AddDamage(const SDL_Rect& rect);
+
+		/*!
+		Records and draws, clipped to area, every object that overlaps it.
+		*/
+		void PaintRegion(const SDL_Rect& area);
+
+		/*!
+		Draws the sorted draw list into the software framebuffer, limited
+		to area, by binning its commands into tiles and rasterizing the
+		tiles on the worker pool.  Each tile draws its commands in list
+		order, so every pixel ends up exactly as DrawCommands leaves it.
+		*/
+		void DrawCommandsTiled(const DrawList& draw_list, const SDL_Rect& area);
+
+
+		/*!
+		Records the scene into the back snapshot and publishes it.
+		*/
+		void PublishSnapshot() override;
+
+		//TODO: add docs
+		bool AcquireSnapshot() override;
+
+		/*!
+		Returns whether the last frame is kept for damage tracking to
+		repaint into: the canvas texture, or the software framebuffer.
+		*/
+		bool HasCanvas() const;
+
+		/*!
+		Appends every object whose bounds might touch area to candidates_,
+		from the spatial grid, which both storages keep.
+		*/
+		void CollectCandidates(const SDL_Rect& area);
+
+		/*!
+		Records the objects of layer whose bounds overlap area into the
+		draw list in draw order by merging the shape arrays, with a tight
+		loop over each run of one kind.  Returns the number recorded.
+		*/
+		unsigned RecordShapeArrays(const SDL_Rect& area, unsigned layer);
+
+		/*!
+		Drops the removed entries from objects_, keeping draw order.
+		*/
+		void CompactObjects();
+
+		/*!
+		Moves the bodies, then calls Update(dt).
+		*/
+		void Advance(double dt) override;
+
+		/*!
+		Moves every body by dt seconds of its velocity.  With a contact
+		callback set, each moving body is first swept against the objects
+		its path crosses; a body that would touch one stops where it first
+		does, and its contacts are passed to the callback in one batch
+		after every body has moved.
+		*/
+		void StepBodies(double dt);
+
+		/*!
+		Finds the earliest contacts of the body at index over a step of
+		dt seconds, appending them to contacts_ and to body_stops_.
+		reach is the farthest any body moves during the step.
+		*/
+		void FindContacts(size_t index, float dt, float reach);
+
+	private:
+		/* Sorts candidates_ by draw order and drops those that fail keep */
+		template <typename Predicate>
+		void FilterCandidates(Predicate keep);
+
+	public:
+		static const size_t kMaxDamageRects = 16;
+
+		/* Edge of a square tile, in pixels, unless set otherwise */
+		static const int kDefaultTileSize = 64;
+
+		/* Removed entries objects_ tolerates before compacting, as long as
+		*  they are also at most half of it */
+		static const size_t kMinCompaction = 64;
+
+		//TODO: add docs
+		ObjectWindow(const string& title, int width, int height,
+			const Color& background);
+
+		/*!
+		Creates an object window in the given mode; see Window.
+		*/
+		ObjectWindow(const string& title, int width, int height,
+			const Color& background, WindowMode mode);
+
+		/*!
+		Destroys the canvas and the layer caches.
+		*/
+		~ObjectWindow();
+
+		//TODO: add docs
+		void PrePaint() override;
+		
+		//TODO: add docs
+		void Paint() override;
+		
+		//TODO: add docs
+		void PostPaint() override;
+
+		//TODO: add docs
+		void Add(GraphicalObject* obj);
+
+		/*!
+		Removes obj from the window in constant time.  The object is not
+		destroyed and may be added again.
+		*/
+		void Remove(GraphicalObject* obj);
+
+		/*!
+		Sets the font like Window::SetFont, then lays out again every Text
+		in the window.
+		*/
+		void SetFont(const GlyphAtlas& font) override;
+
+		/*!
+		Constructs a T owned by the window, passing the window and args to
+		its constructor, and adds it.  For example
+		Create<Rectangle>(Color(255, 0, 0), x, y, width, height).  The
+		object lives until Destroy or until the window is destroyed.
+		*/
+		template <typename T, typename... Args>
+		Handle<T> Create(Args&&... args);
+
+		/*!
+		Returns the object handle refers to, or nullptr if it has been
+		destroyed.
+		*/
+		template <typename T>
+		T* Get(const Handle<T>& handle) const;
+
+		/*!
+		Returns a handle to obj, or a null handle if obj was not made by
+		Create.
+		*/
+		Handle<GraphicalObject> GetHandle(const GraphicalObject* obj) const;
+
+		/*!
+		Removes and destroys an object made by Create.  Returns false, and
+		does nothing, if the handle is stale.
+		*/
+		bool Destroy(const Handle<GraphicalObject>& handle);
+
+		/*!
+		Returns a pointer to the first GraphicalObject found that intersects with the point (x, y). Returns nullptr if no object found. 
+		*/
+		GraphicalObject* GetFirstHit(int x, int y);
+
+		/*!
+		Fills results with every object that Hit(x, y), in draw order.
+		*/
+		void QueryPoint(int x, int y, vector<GraphicalObject*>& results);
+
+		/*!
+		Fills results with every object whose bounds intersect rect, using
+		the same inclusive edges as Collision, in draw order.
+		*/
+		void QueryRect(const SDL_Rect& rect, vector<GraphicalObject*>& results);
+
+		/*!
+		Calls callback for every other object that obj->Collision reports,
+		in draw order.  The matches are collected before the first call, so
+		the callback may Remove objects.
+		*/
+		void ForEachCollision(GraphicalObject* obj,
+			const std::function<void(GraphicalObject*)>& callback);
+
+		/*!
+		Calls callback once for every pair of colliding objects, found with
+		sweep and prune along x.  The sweep order is kept between calls, so
+		mostly-static scenes re-sort in near linear time.
+		*/
+		void ForEachCollisionPair(
+			const std::function<void(GraphicalObject*, GraphicalObject*)>& callback);
+
+		/*!
+		Changes the cell size of the spatial index and rebuilds it.  Cells
+		around the size of a typical object work best.
+		*/
+		void SetGridCellSize(int cell_size);
+
+		/*!
+		Returns the list that objects record their primitives into while
+		the window is being painted.
+		*/
+		DrawList& GetDrawList();
+
+		/*!
+		Enables or disables merging recorded primitives into batches by
+		kind and color.  Enabled by default.
+		*/
+		void SetDrawSorting(bool enabled);
+
+		/*!
+		Called by GraphicalObject setters.  Keeps the spatial index in step
+		with the object's new bounds and damages the old and new bounds.
+		*/
+		virtual void ObjectChanged(GraphicalObject* obj, const SDL_Rect& old_rect);
+
+		/*!
+		Enables or disables damage tracking.  When enabled the window keeps
+		its last frame in a render-target texture and only clears and
+		repaints the regions touched by Add, Remove and object setters,
+		and mutations request a repaint on their own.  Anything drawn
+		directly in Paint() is clipped to the damaged regions, so windows
+		that draw outside of GraphicalObjects should leave this off.
+		Disabled by default, and ignored if the renderer has no render
+		target support.
+		*/
+		void SetDamageTracking(bool enabled);
+
+		/*!
+		Switches backends and repaints the whole window.  The software
+		framebuffer keeps the last frame, so with damage tracking it takes
+		the place of the render-target canvas.
+		*/
+		void SetRenderBackend(RenderBackend backend) override;
+
+		/*!
+		Chooses how objects are painted.  The default, kObjects, calls each
+		object's Paint.  kArrays also copies every object into per-shape
+		arrays and paints them with loops over the arrays, with no virtual
+		call per built-in shape; it suits scenes with many built-in shapes.
+		Both keep the objects in the spatial grid, so hit tests and other
+		queries cost the same in either.  Objects already added are copied
+		into the arrays or dropped from them.
+		*/
+		void SetObjectStorage(ObjectStorage storage);
+
+		//TODO: add docs
+		ObjectStorage GetObjectStorage() const;
+
+		/*!
+		Rasterizes the recorded objects in tiles of tile_size pixels on
+		threads threads, the painting thread included, which switches the
+		window to the software backend.  Objects are still painted into
+		the draw list on the calling thread; only rasterizing is spread
+		out.  The result is identical to drawing on one thread.  0
+		threads turns tiled rendering off, leaving the backend as it is.
+		*/
+		void SetTiledRendering(unsigned threads, int tile_size = kDefaultTileSize);
+
+		/*!
+		Returns the number of threads rasterizing tiles, or 0 when tiled
+		rendering is off.
+		*/
+		unsigned GetRenderThreads() const;
+
+		/*!
+		Makes Run pipelined: Update and the event handlers run on a
+		simulation thread, which after every change records the objects
+		into a snapshot, while the main thread paints the latest snapshot
+		and presents it.  Frames are no longer held back by a slow Update.
+		Call it before Run; Step and RenderFrame are not affected.
+
+		While pipelined, Update and the handlers own the objects and the
+		draw list, and must not call SDL or draw directly.  Object setters
+		touch no SDL state, so they are safe there; cached textures are
+		only created and evicted while painting on the main thread.
+		Damage tracking is off, as every snapshot is painted whole.
+		*/
+		void SetPipelined(bool enabled);
+
+		//TODO: add docs
+		bool GetPipelined() const;
+
+		/*!
+		Makes the window show the world through camera: the world point
+		(camera.x, camera.y) at its top left corner, magnified camera.zoom
+		times, which is clamped to at least kMinZoom.  Objects outside the
+		view are not painted at all.  Object positions, hit tests and
+		queries stay in world coordinates; everything recorded into the
+		draw list is transformed, while immediate Draw* calls are in
+		screen pixels.  Repaints the whole window.  The default camera is
+		(0, 0) at zoom 1, where world and screen coincide.
+		*/
+		void SetCamera(const Camera& camera);
+
+		//TODO: add docs
+		const Camera& GetCamera() const;
+
+		/*!
+		Returns the world point under the screen pixel (x, y).
+		*/
+		SDL_Point ScreenToWorld(int x, int y) const;
+
+		/*!
+		Returns the world rect the window shows.
+		*/
+		SDL_Rect GetVisibleWorldRect() const;
+
+		/* Smallest zoom SetCamera accepts */
+		static constexpr float kMinZoom = 1.0f / 1024.0f;
+
+		/*!
+		Sets the function the contacts found by each step of the bodies
+		are passed to, or with an empty one stops looking for contacts,
+		so bodies move freely and overlap.  The callback may change,
+		Remove or Destroy objects; contacts later in the batch then report
+		removed objects as nullptr.  Two moving bodies that meet are
+		reported once from each side, and an object a body already
+		overlaps when the step starts is not reported.
+		*/
+		void SetContactCallback(const std::function<void(Span<const Contact>)>& callback);
+
+		/*!
+		Adds a layer named name.  Layers are painted in order of z, and
+		layers of equal z in the order they were added; within a layer,
+		objects keep their draw order.  A kStatic layer is painted once
+		into a texture, which every frame then copies in one call, and is
+		painted again only after one of its objects is added, removed or
+		changed, or the camera moves.  Static layers suit many objects
+		that rarely change, such as a level's walls.  Without render
+		targets, or on the software backend, static layers are painted
+		like dynamic ones.  Returns false if the name is taken.
+		*/
+		bool AddLayer(const string& name, int z, LayerMode mode);
+
+		/*!
+		Changes the z of the named layer.  Returns false if there is no
+		such layer.
+		*/
+		bool SetLayerZ(const string& name, int z);
+
+		/*!
+		Moves obj to the named layer.  Every object starts in
+		kDefaultLayer, a dynamic layer at z 0.  Returns false, leaving obj
+		where it is, if there is no such layer.
+		*/
+		bool SetLayer(GraphicalObject* obj, const string& name);
+
+		/*!
+		Returns the name of the layer obj is in.
+		*/
+		const string& GetLayer(const GraphicalObject* obj) const;
+
+		/* Name of the layer objects are created in */
+		static const string kDefaultLayer;
 	};
 }
 
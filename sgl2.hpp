@@ -3,404 +3,4819 @@
 
 #include "sgl2.h"
 #include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <typeinfo>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SGL2_AVX2 1
+#define SGL2_SSE2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SGL2_SSE2 1
+#endif
 
 namespace sgl2 {
 
-	Color::Color(Uint8 r, Uint8 g, Uint8 b, Uint8 a)
-		: red(r < 0 ? 0 : (r > 255) ? 255 : r),
-		green(g < 0 ? 0 : (g > 255) ? 255 : g),
-		blue(b < 0 ? 0 : (b > 255) ? 255 : b),
-		alpha(a < 0 ? 0 : (a > 255) ? 255 : a) {};
+	constexpr Color::Color(Uint8 r, Uint8 g, Uint8 b, Uint8 a)
+		: argb_(((Uint32)a << 24) | ((Uint32)r << 16) | ((Uint32)g << 8) | b) {}
 
-	//--------------BASE WINDOW CLASS-----------------------//
+	constexpr Color Color::FromArgb(Uint32 argb) {
+		return Color((Uint8)(argb >> 16), (Uint8)(argb >> 8), (Uint8)argb, (Uint8)(argb >> 24));
+	}
+
+	constexpr Uint8 Color::GetRed() const { return (Uint8)(argb_ >> 16); }
+
+	constexpr Uint8 Color::GetGreen() const { return (Uint8)(argb_ >> 8); }
+
+	constexpr Uint8 Color::GetBlue() const { return (Uint8)argb_; }
+
+	constexpr Uint8 Color::GetAlpha() const { return (Uint8)(argb_ >> 24); }
+
+	constexpr Uint32 Color::GetArgb() const { return argb_; }
+
+	constexpr Color Color::kBlack(0, 0, 0);
+	constexpr Color Color::kWhite(255, 255, 255);
+	constexpr Color Color::kRed(255, 0, 0);
+	constexpr Color Color::kGreen(0, 255, 0);
+	constexpr Color Color::kBlue(0, 0, 255);
+	constexpr Color Color::kYellow(255, 255, 0);
+	constexpr Color Color::kCyan(0, 255, 255);
+	constexpr Color Color::kMagenta(255, 0, 255);
+	constexpr Color Color::kTransparent(0, 0, 0, 0);
+
+	static_assert(sizeof(Color) == 4 && std::is_trivially_copyable<Color>::value,
+		"Color must stay one trivially copied 32-bit word");
+
+	constexpr bool operator==(const Color& lhs, const Color& rhs) {
+		return lhs.GetArgb() == rhs.GetArgb();
+	}
+
+	constexpr bool operator!=(const Color& lhs, const Color& rhs) { return !(lhs == rhs); }
+
+	//--------------DRAW LIST CLASS-------------------------//
 	//------------------------------------------------------//
 	//------------------------------------------------------//
 	//------------------------------------------------------//
 
-	Window::Window(const string& title, int width, int height,
-		const Color& background)
-		: invalid_(true), background_color_(background), running_(false) {
-		if (SDL_Init(SDL_INIT_EVERYTHING)) return;
-		if (SDL_CreateWindowAndRenderer(width, height, SDL_WINDOW_SHOWN, &window_,
-			&renderer_))
-			return;
-		SDL_SetWindowTitle(window_, title.c_str());
+	static bool RectsOverlap(const SDL_Rect& a, const SDL_Rect& b) {
+		return a.x < b.x + b.w && b.x < a.x + a.w &&
+			a.y < b.y + b.h && b.y < a.y + a.h;
 	}
 
-	void Window::SetBackgroundColor(const Color& color) { background_color_ = color; }
-
-	void Window::PrePaint() {
-		SDL_SetRenderDrawColor(renderer_, background_color_.red, background_color_.green, background_color_.blue, background_color_.alpha);
-		SDL_RenderClear(renderer_);
+	static SDL_Rect RectUnion(const SDL_Rect& a, const SDL_Rect& b) {
+		int left = std::min(a.x, b.x), top = std::min(a.y, b.y);
+		int right = std::max(a.x + a.w, b.x + b.w);
+		int bottom = std::max(a.y + a.h, b.y + b.h);
+		return SDL_Rect{ left, top, right - left, bottom - top };
 	}
 
-	void Window::PostPaint() {
-		SDL_RenderPresent(renderer_);
-		invalid_ = false;
+	void DrawList::Clear() {
+		recorded_.clear();
+		sorted_.clear();
+		batches_.clear();
+		vertices_.clear();
+		glyphs_.clear();
+		sprites_.clear();
 	}
 
-	void Window::PaintAll() {
-		PrePaint();
-		Paint();
-		PostPaint();
+	void DrawList::AddPoint(Color color, int x, int y) {
+		recorded_.push_back(DrawCommand{ DrawKind::kPoint, color, SDL_Rect{ x, y, 1, 1 }, 0, 0 });
 	}
 
-	void Window::Repaint() { invalid_ = true; }
-
-	void Window::DrawPoint(Color color, int x, int y) {
-		SDL_SetRenderDrawColor(renderer_, color.red, color.green, color.blue,
-			color.alpha);
-		SDL_RenderDrawPoint(renderer_, x, y);
+	void DrawList::AddRectangle(Color color, const SDL_Rect& rect, bool filled) {
+		recorded_.push_back(DrawCommand{
+			filled ? DrawKind::kFilledRectangle : DrawKind::kRectangle, color, rect, 0, 0 });
 	}
 
-	void Window::DrawPoint(int x, int y) {
-		SDL_RenderDrawPoint(renderer_, x, y);
+	void DrawList::AddCircle(Color color, int x, int y, int radius, bool filled) {
+		recorded_.push_back(DrawCommand{
+			filled ? DrawKind::kFilledCircle : DrawKind::kCircle, color,
+			SDL_Rect{ x - radius, y - radius, 2 * radius + 1, 2 * radius + 1 }, 0, 0 });
 	}
 
-	void Window::DrawRectangle(Color color, const SDL_Rect& rect) {
-		SDL_SetRenderDrawColor(renderer_, color.red, color.green, color.blue,
-			color.alpha);
-		SDL_RenderDrawRect(renderer_, &rect);
+	void DrawList::AddPolyline(Color color, const SDL_Point* points, size_t count, int x, int y) {
+		if (count == 0)
+			return;
+		Uint32 first = (Uint32)vertices_.size();
+		int left = INT_MAX, top = INT_MAX, right = INT_MIN, bottom = INT_MIN;
+		for (size_t i = 0; i < count; i++) {
+			SDL_Point vertex{ points[i].x + x, points[i].y + y };
+			left = std::min(left, vertex.x);
+			top = std::min(top, vertex.y);
+			right = std::max(right, vertex.x);
+			bottom = std::max(bottom, vertex.y);
+			vertices_.push_back(vertex);
+		}
+		recorded_.push_back(DrawCommand{ DrawKind::kPolyline, color,
+			SDL_Rect{ left, top, right - left + 1, bottom - top + 1 }, first, (Uint32)count });
 	}
 
-	void Window::DrawFilledRectangle(Color color, const SDL_Rect & rect) {
-		SDL_SetRenderDrawColor(renderer_, color.red, color.green, color.blue,
-			color.alpha);
-		SDL_RenderFillRect(renderer_, &rect);
+	void DrawList::AddGlyphs(Color color, const GlyphQuad* glyphs, size_t count, int x, int y) {
+		if (count == 0)
+			return;
+		Uint32 first = (Uint32)glyphs_.size();
+		SDL_Rect bounds = glyphs[0].dest;
+		for (size_t i = 0; i < count; i++) {
+			GlyphQuad glyph = glyphs[i];
+			glyph.dest.x += x;
+			glyph.dest.y += y;
+			bounds = i ? RectUnion(bounds, glyph.dest) : glyph.dest;
+			glyphs_.push_back(glyph);
+		}
+		recorded_.push_back(DrawCommand{ DrawKind::kText, color, bounds, first, (Uint32)count });
 	}
 
-	// Draws eight points on the rim of a circle reflected from
-	// one point across eight octants.
-	// (edge_x, edge_y) is a point on the rim.
-	// (center_x, center_y) is the circle's center.
-	// Adapted from 
-	// Computer Graphics: The Principles behind the Art and Science
-	// Cornel Pokorny and Curtis Gerald (c) 1989
-	inline void Window::EightOcts(int edge_x, int edge_y,
-		int center_x, int center_y) {
-		DrawPoint(edge_x + center_x, edge_y + center_y);
-		DrawPoint(-edge_x + center_x, edge_y + center_y);
-		DrawPoint(edge_x + center_x, -edge_y + center_y);
-		DrawPoint(-edge_x + center_x, -edge_y + center_y);
-		DrawPoint(edge_y + center_x, edge_x + center_y);
-		DrawPoint(-edge_y + center_x, edge_x + center_y);
-		DrawPoint(edge_y + center_x, -edge_x + center_y);
-		DrawPoint(-edge_y + center_x, -edge_x + center_y);
+	void DrawList::AddSprite(const SpriteImage& image, const SDL_Rect& dest, Color tint) {
+		if (image.page < 0)
+			return;
+		recorded_.push_back(DrawCommand{ DrawKind::kSprite, tint, dest, (Uint32)sprites_.size(), 1 });
+		sprites_.push_back(SpriteQuad{ image.source, dest, tint, image.page });
 	}
 
-	void Window::DrawCircle(Color color, int x, int y, int radius) {
-		SDL_SetRenderDrawColor(renderer_, color.red, color.green, color.blue,
-			color.alpha);
-
-		// Implements Bresenham's circle generation algorithm to draw
-		// the an arc on a circle from 90 degrees to 45 degrees.  Calls
-		// eight_octs function to render the complete circle.
-		// (x, y) is the circle's center.
-		// radius is the circle's radius.
-		// Adapted from 
-		// Computer Graphics: The Principles behind the Art and Science
-		// Cornel Pokorny and Curtis Gerald (c) 1989
-
-		// Start at 90 degrees
-		int current_x = 0, current_y = radius, s = 3 - 2 * radius;
-		while (current_x < current_y) {  // Stop at 45 degrees
-			EightOcts(current_x, current_y, x, y);
-			if (s <= 0)
-				s = s + 4 * current_x + 6;
-			else {
-				s = s + 4 * (current_x - current_y) + 10;
-				current_y--;
-			}
-			current_x++;
-		}
-		if (current_x == current_y)
-			EightOcts(current_x, current_y, x, y);
+	// Kept well inside int so that far off-screen shapes cannot overflow
+	// when their size is added to their position.
+	static int CameraToScreen(double world, double origin, double zoom) {
+		return (int)std::max(-1073741824.0, std::min(std::floor((world - origin) * zoom), 1073741824.0));
 	}
 
-	// Adapted from 
-	// http://stackoverflow.com/questions/1201200/fast-algorithm-for-drawing-filled-circles 
-	void Window::DrawFilledCircle(Color color, int x, int y, int radius) {
-		SDL_SetRenderDrawColor(renderer_, color.red, color.green, color.blue,
-			color.alpha);
-		for (int edge_y = -radius; edge_y <= radius; edge_y++)
-			for (int edge_x = -radius; edge_x <= radius; edge_x++)
-				if (edge_x*edge_x + edge_y*edge_y <= radius*radius)
-					DrawPoint(x + edge_x, y + edge_y);
+	// A span of w units from x covers the pixels between the ones its two
+	// edges fall on, and never shrinks to nothing.
+	static void SpanToScreen(int& x, int& w, double origin, double zoom) {
+		int left = CameraToScreen(x, origin, zoom);
+		int right = CameraToScreen((double)x + w, origin, zoom);
+		x = left;
+		w = w > 0 ? std::max(right - left, 1) : 0;
 	}
 
-	void Window::Update() {}
-
-	void Window::Run() {
-		running_ = true;
-		while (running_) {
-			SDL_Event event;
-			while (SDL_PollEvent(&event)) {
-				switch (event.type) {
-				case SDL_QUIT:
-					running_ = false;
-					break;
-				case SDL_KEYDOWN:
-					KeyPressed(event.key);
+	void DrawList::ApplyCamera(const Camera& camera, const SDL_Rect& visible) {
+		bool identity = camera.x == 0.0f && camera.y == 0.0f && camera.zoom == 1.0f;
+		double zoom = camera.zoom;
+		size_t kept = 0;
+		for (size_t i = 0; i < recorded_.size(); i++) {
+			DrawCommand command = recorded_[i];
+			SDL_Rect& rect = command.rect;
+			if (!identity) {
+				switch (command.kind) {
+				case DrawKind::kPoint:
+					rect.x = CameraToScreen(rect.x, camera.x, zoom);
+					rect.y = CameraToScreen(rect.y, camera.y, zoom);
 					break;
-				case SDL_MOUSEMOTION:
-					MouseMoved(event.motion);
+				case DrawKind::kRectangle:
+				case DrawKind::kFilledRectangle:
+					SpanToScreen(rect.x, rect.w, camera.x, zoom);
+					SpanToScreen(rect.y, rect.h, camera.y, zoom);
 					break;
-				case SDL_MOUSEBUTTONDOWN:
-					MousePressed(event.button);
+				case DrawKind::kCircle:
+				case DrawKind::kFilledCircle: {
+					// The center is the middle of its pixel, so a circle
+					// stays centered on the square it was drawn in
+					int radius_x = rect.w / 2, radius_y = rect.h / 2;
+					int center_x = CameraToScreen(rect.x + radius_x + 0.5, camera.x, zoom);
+					int center_y = CameraToScreen(rect.y + radius_y + 0.5, camera.y, zoom);
+					radius_x = (int)(radius_x * zoom + 0.5);
+					radius_y = (int)(radius_y * zoom + 0.5);
+					rect = SDL_Rect{ center_x - radius_x, center_y - radius_y, 2 * radius_x + 1, 2 * radius_y + 1 };
 					break;
-				case SDL_MOUSEBUTTONUP:
-					MouseReleased(event.button);
+				}
+				case DrawKind::kPolyline: {
+					int left = INT_MAX, top = INT_MAX, right = INT_MIN, bottom = INT_MIN;
+					for (Uint32 v = 0; v < command.item_count; v++) {
+						SDL_Point& vertex = vertices_[command.first_item + v];
+						vertex.x = CameraToScreen(vertex.x, camera.x, zoom);
+						vertex.y = CameraToScreen(vertex.y, camera.y, zoom);
+						left = std::min(left, vertex.x);
+						top = std::min(top, vertex.y);
+						right = std::max(right, vertex.x);
+						bottom = std::max(bottom, vertex.y);
+					}
+					rect = SDL_Rect{ left, top, right - left + 1, bottom - top + 1 };
 					break;
-				case SDL_WINDOWEVENT:
-					switch (event.window.event) {
-					case SDL_WINDOWEVENT_ENTER:
-						MouseEntered();
-						break;
-					case SDL_WINDOWEVENT_LEAVE:
-						MouseExited();
-						break;
+				}
+				case DrawKind::kText:
+					for (Uint32 g = 0; g < command.item_count; g++) {
+						SDL_Rect& dest = glyphs_[command.first_item + g].dest;
+						SpanToScreen(dest.x, dest.w, camera.x, zoom);
+						SpanToScreen(dest.y, dest.h, camera.y, zoom);
+						rect = g ? RectUnion(rect, dest) : dest;
 					}
 					break;
+				case DrawKind::kSprite:
+					SpanToScreen(rect.x, rect.w, camera.x, zoom);
+					SpanToScreen(rect.y, rect.h, camera.y, zoom);
+					sprites_[command.first_item].dest = rect;
+					break;
 				}
 			}
 
-			Update();
+			// Items of dropped commands are left in place, unreferenced
+			SDL_Rect bounds{ rect.x, rect.y, std::max(rect.w, 1), std::max(rect.h, 1) };
+			if (RectsOverlap(bounds, visible))
+				recorded_[kept++] = command;
+		}
+		recorded_.erase(recorded_.begin() + kept, recorded_.end());
+	}
 
-			if (invalid_) {
-				PaintAll();
+	// Each command joins the most recent batch with the same kind and color,
+	// or for sprites the same page, unless a batch in between overlaps it:
+	// that batch was recorded earlier and must stay underneath, so the
+	// command starts a new batch instead.  Batch bounds are a conservative
+	// union, so some mergeable commands are split, but never the other way
+	// around.
+	void DrawList::Sort(bool merge) {
+		batches_.clear();
+		batch_of_.resize(recorded_.size());
+		for (size_t i = 0; i < recorded_.size(); i++) {
+			const DrawCommand& command = recorded_[i];
+			int page = command.kind == DrawKind::kSprite ? sprites_[command.first_item].page : 0;
+			size_t target = batches_.size();
+			size_t lookback = merge ? std::min(batches_.size(), kMaxLookback) : 0;
+			for (size_t b = batches_.size(); b > batches_.size() - lookback; b--) {
+				DrawBatch& batch = batches_[b - 1];
+				if (batch.kind == command.kind && batch.page == page &&
+					(batch.color == command.color || command.kind == DrawKind::kSprite)) {
+					target = b - 1;
+					break;
+				}
+				if (RectsOverlap(batch.bounds, command.rect))
+					break;
 			}
+			if (target == batches_.size())
+				batches_.push_back(DrawBatch{ command.kind, command.color, page, command.rect, 0, 0 });
+			else
+				batches_[target].bounds = RectUnion(batches_[target].bounds, command.rect);
+			batches_[target].count++;
+			batch_of_[i] = target;
 		}
-	}
 
-	void Window::Quit()
-	{
-		running_ = false;
+		// Counting sort of the commands by batch, stable within a batch
+		size_t first = 0;
+		for (DrawBatch& batch : batches_) {
+			batch.first = first;
+			first += batch.count;
+			batch.count = 0;
+		}
+		sorted_.assign(recorded_.begin(), recorded_.end());
+		for (size_t i = 0; i < recorded_.size(); i++) {
+			DrawBatch& batch = batches_[batch_of_[i]];
+			sorted_[batch.first + batch.count++] = recorded_[i];
+		}
 	}
 
-	void Window::KeyPressed(const KeyboardEvent & event) {}
+	const size_t DrawList::kMaxLookback;
 
-	inline void Window::MouseMoved(const MouseMotionEvent & event) {}
+	const vector<DrawCommand>& DrawList::Commands() const { return sorted_; }
 
-	inline void Window::MousePressed(const MouseButtonEvent & event) {}
+	const vector<DrawBatch>& DrawList::Batches() const { return batches_; }
 
-	inline void Window::MouseReleased(const MouseButtonEvent & event) {}
+	const vector<SDL_Point>& DrawList::Vertices() const { return vertices_; }
 
-	inline void Window::MouseEntered() {}
+	const vector<GlyphQuad>& DrawList::Glyphs() const { return glyphs_; }
 
-	inline void Window::MouseExited() {}
+	const vector<SpriteQuad>& DrawList::Sprites() const { return sprites_; }
+
+	size_t DrawList::Size() const { return recorded_.size(); }
 
 	//------------------------------------------------------//
 	//------------------------------------------------------//
 	//------------------------------------------------------//
 
-	//--------------GRAPHICAL OBJECT CLASS------------------//
+	//--------------SHAPE CACHE CLASS-----------------------//
 	//------------------------------------------------------//
 	//------------------------------------------------------//
 	//------------------------------------------------------//
 
-	GraphicalObject::GraphicalObject(ObjectWindow* window, Color color)
-		: window_(window), color_(color), filled_(false), id_(id_source_++) {
-		rect_ = SDL_Rect{ 0, 0, 0, 0 };
-	}
-
-	GraphicalObject::GraphicalObject(ObjectWindow* window, Color color, bool filled)
-		: window_(window), color_(color), filled_(filled), id_(id_source_++) {
-		rect_ = SDL_Rect{ 0, 0, 0, 0 };
-	}
-
-	GraphicalObject::GraphicalObject(ObjectWindow* window, Color color, int x,
-		int y)
-		: window_(window), color_(color), filled_(false), id_(id_source_++) {
-		rect_ = SDL_Rect{ x, y, 0, 0 };
-	}
-
-	int GraphicalObject::GetPosX() { return rect_.x; }
-
-	int GraphicalObject::GetPosY() { return rect_.y; }
-
-	void GraphicalObject::SetPosX(int x) { rect_.x = x; }
+	const size_t ShapeCache::kDefaultBudget;
 
-	void GraphicalObject::SetPosY(int y) { rect_.y = y; }
+	ShapeCache::ShapeCache(size_t budget)
+		: budget_(budget), bytes_used_(0), stats_() {}
 
-	int GraphicalObject::GetWidth()
-	{
-		return rect_.w;
-	}
+	ShapeCache::~ShapeCache() { Clear(); }
 
-	int GraphicalObject::GetHeight()
-	{
-		return rect_.h;
+	Uint64 ShapeCache::CircleKey(int radius, Color color, bool filled) {
+		return ((Uint64)(Uint32)radius << 33) | ((Uint64)color.GetArgb() << 1) | (filled ? 1 : 0);
 	}
 
-	void GraphicalObject::SetWidth(int width)
-	{
-		rect_.w = width;
+	SDL_Texture* ShapeCache::Find(Uint64 key) {
+		auto it = index_.find(key);
+		if (it == index_.end()) {
+			stats_.misses++;
+			return nullptr;
+		}
+		stats_.hits++;
+		lru_.splice(lru_.begin(), lru_, it->second);
+		return it->second->texture;
 	}
 
-	void GraphicalObject::SetHeight(int height)
-	{
-		rect_.h = height;
+	bool ShapeCache::Insert(Uint64 key, SDL_Texture* texture, size_t bytes) {
+		if (bytes > budget_)
+			return false;
+		Erase(key);
+		EvictTo(budget_ - bytes);
+		lru_.push_front(Entry{ key, texture, bytes });
+		index_[key] = lru_.begin();
+		bytes_used_ += bytes;
+		return true;
 	}
 
-	void GraphicalObject::SetFilled(bool filled)
-	{
-		filled_ = filled;
+	void ShapeCache::Erase(Uint64 key) {
+		auto it = index_.find(key);
+		if (it == index_.end())
+			return;
+		SDL_DestroyTexture(it->second->texture);
+		bytes_used_ -= it->second->bytes;
+		lru_.erase(it->second);
+		index_.erase(it);
 	}
 
-	bool GraphicalObject::Hit(int x, int y)
-	{
-		if (x >= rect_.x &&
-			x <= rect_.x + rect_.w &&
-			y >= rect_.y &&
-			y <= rect_.y + rect_.h)
-		{
-			return true;
+	void ShapeCache::EvictTo(size_t budget) {
+		while (bytes_used_ > budget && !lru_.empty()) {
+			Entry& oldest = lru_.back();
+			SDL_DestroyTexture(oldest.texture);
+			bytes_used_ -= oldest.bytes;
+			index_.erase(oldest.key);
+			lru_.pop_back();
+			stats_.evictions++;
 		}
+	}
 
-		return false;
+	void ShapeCache::Clear() {
+		for (Entry& entry : lru_)
+			SDL_DestroyTexture(entry.texture);
+		lru_.clear();
+		index_.clear();
+		bytes_used_ = 0;
 	}
 
-	bool GraphicalObject::Collision(GraphicalObject* obj)
-	{
-		//collision code written from scratch (no outside sources consulted, so it may have bugs)
-		GraphicalObject* rect1 = this;
-		GraphicalObject* rect2 = obj;
+	void ShapeCache::SetBudget(size_t bytes) {
+		budget_ = bytes;
+		EvictTo(budget_);
+	}
 
-		if (rect1->GetPosX() + rect1->GetWidth() >= rect2->GetPosX() &&
-			rect1->GetPosX() <= rect2->GetPosX() + rect2->GetWidth() &&
-			rect1->GetPosY() + rect1->GetHeight() >= rect2->GetPosY() &&
-			rect1->GetPosY() <= rect2->GetPosY() + rect2->GetHeight()) {
-			return true;
-		}
+	size_t ShapeCache::GetBudget() const { return budget_; }
 
-		return false;
+	ShapeCacheStats ShapeCache::GetStats() const {
+		ShapeCacheStats stats = stats_;
+		stats.entries = lru_.size();
+		stats.bytes_used = bytes_used_;
+		return stats;
 	}
 
-	unsigned GraphicalObject::id_source_ = 0;
+	void ShapeCache::ResetStats() {
+		stats_.hits = 0;
+		stats_.misses = 0;
+		stats_.evictions = 0;
+	}
 
 	//------------------------------------------------------//
 	//------------------------------------------------------//
 	//------------------------------------------------------//
 
-	//--------------POINT CLASS-----------------------------//
+	//--------------GLYPH ATLAS CLASS-----------------------//
 	//------------------------------------------------------//
 	//------------------------------------------------------//
 	//------------------------------------------------------//
 
-	Point::Point(ObjectWindow* window, Color color, int x, int y)
-		: GraphicalObject(window, color, x, y) {}
+	// The built-in font: printable ASCII, 5x7, five columns per glyph
+	// with bit 0 the top row.
+	static const Uint8 kBuiltInGlyphs[95 * 5] = {
+		0x00, 0x00, 0x00, 0x00, 0x00,  // space
+		0x00, 0x00, 0x5F, 0x00, 0x00,  // !
+		0x00, 0x07, 0x00, 0x07, 0x00,  // "
+		0x14, 0x7F, 0x14, 0x7F, 0x14,  // #
+		0x24, 0x2A, 0x7F, 0x2A, 0x12,  // $
+		0x23, 0x13, 0x08, 0x64, 0x62,  // %
+		0x36, 0x49, 0x55, 0x22, 0x50,  // &
+		0x00, 0x05, 0x03, 0x00, 0x00,  // '
+		0x00, 0x1C, 0x22, 0x41, 0x00,  // (
+		0x00, 0x41, 0x22, 0x1C, 0x00,  // )
+		0x08, 0x2A, 0x1C, 0x2A, 0x08,  // *
+		0x08, 0x08, 0x3E, 0x08, 0x08,  // +
+		0x00, 0x50, 0x30, 0x00, 0x00,  // ,
+		0x08, 0x08, 0x08, 0x08, 0x08,  // -
+		0x00, 0x60, 0x60, 0x00, 0x00,  // .
+		0x20, 0x10, 0x08, 0x04, 0x02,  // /
+		0x3E, 0x51, 0x49, 0x45, 0x3E,  // 0
+		0x00, 0x42, 0x7F, 0x40, 0x00,  // 1
+		0x42, 0x61, 0x51, 0x49, 0x46,  // 2
+		0x21, 0x41, 0x45, 0x4B, 0x31,  // 3
+		0x18, 0x14, 0x12, 0x7F, 0x10,  // 4
+		0x27, 0x45, 0x45, 0x45, 0x39,  // 5
+		0x3C, 0x4A, 0x49, 0x49, 0x30,  // 6
+		0x01, 0x71, 0x09, 0x05, 0x03,  // 7
+		0x36, 0x49, 0x49, 0x49, 0x36,  // 8
+		0x06, 0x49, 0x49, 0x29, 0x1E,  // 9
+		0x00, 0x36, 0x36, 0x00, 0x00,  // :
+		0x00, 0x56, 0x36, 0x00, 0x00,  // ;
+		0x08, 0x14, 0x22, 0x41, 0x00,  // <
+		0x14, 0x14, 0x14, 0x14, 0x14,  // =
+		0x00, 0x41, 0x22, 0x14, 0x08,  // >
+		0x02, 0x01, 0x51, 0x09, 0x06,  // ?
+		0x32, 0x49, 0x79, 0x41, 0x3E,  // @
+		0x7E, 0x11, 0x11, 0x11, 0x7E,  // A
+		0x7F, 0x49, 0x49, 0x49, 0x36,  // B
+		0x3E, 0x41, 0x41, 0x41, 0x22,  // C
+		0x7F, 0x41, 0x41, 0x22, 0x1C,  // D
+		0x7F, 0x49, 0x49, 0x49, 0x41,  // E
+		0x7F, 0x09, 0x09, 0x09, 0x01,  // F
+		0x3E, 0x41, 0x49, 0x49, 0x7A,  // G
+		0x7F, 0x08, 0x08, 0x08, 0x7F,  // H
+		0x00, 0x41, 0x7F, 0x41, 0x00,  // I
+		0x20, 0x40, 0x41, 0x3F, 0x01,  // J
+		0x7F, 0x08, 0x14, 0x22, 0x41,  // K
+		0x7F, 0x40, 0x40, 0x40, 0x40,  // L
+		0x7F, 0x02, 0x0C, 0x02, 0x7F,  // M
+		0x7F, 0x04, 0x08, 0x10, 0x7F,  // N
+		0x3E, 0x41, 0x41, 0x41, 0x3E,  // O
+		0x7F, 0x09, 0x09, 0x09, 0x06,  // P
+		0x3E, 0x41, 0x51, 0x21, 0x5E,  // Q
+		0x7F, 0x09, 0x19, 0x29, 0x46,  // R
+		0x46, 0x49, 0x49, 0x49, 0x31,  // S
+		0x01, 0x01, 0x7F, 0x01, 0x01,  // T
+		0x3F, 0x40, 0x40, 0x40, 0x3F,  // U
+		0x1F, 0x20, 0x40, 0x20, 0x1F,  // V
+		0x3F, 0x40, 0x38, 0x40, 0x3F,  // W
+		0x63, 0x14, 0x08, 0x14, 0x63,  // X
+		0x07, 0x08, 0x70, 0x08, 0x07,  // Y
+		0x61, 0x51, 0x49, 0x45, 0x43,  // Z
+		0x00, 0x7F, 0x41, 0x41, 0x00,  // [
+		0x02, 0x04, 0x08, 0x10, 0x20,  // backslash
+		0x00, 0x41, 0x41, 0x7F, 0x00,  // ]
+		0x04, 0x02, 0x01, 0x02, 0x04,  // ^
+		0x40, 0x40, 0x40, 0x40, 0x40,  // _
+		0x00, 0x01, 0x02, 0x04, 0x00,  // `
+		0x20, 0x54, 0x54, 0x54, 0x78,  // a
+		0x7F, 0x48, 0x44, 0x44, 0x38,  // b
+		0x38, 0x44, 0x44, 0x44, 0x20,  // c
+		0x38, 0x44, 0x44, 0x48, 0x7F,  // d
+		0x38, 0x54, 0x54, 0x54, 0x18,  // e
+		0x08, 0x7E, 0x09, 0x01, 0x02,  // f
+		0x0C, 0x52, 0x52, 0x52, 0x3E,  // g
+		0x7F, 0x08, 0x04, 0x04, 0x78,  // h
+		0x00, 0x44, 0x7D, 0x40, 0x00,  // i
+		0x20, 0x40, 0x44, 0x3D, 0x00,  // j
+		0x7F, 0x10, 0x28, 0x44, 0x00,  // k
+		0x00, 0x41, 0x7F, 0x40, 0x00,  // l
+		0x7C, 0x04, 0x18, 0x04, 0x78,  // m
+		0x7C, 0x08, 0x04, 0x04, 0x78,  // n
+		0x38, 0x44, 0x44, 0x44, 0x38,  // o
+		0x7C, 0x14, 0x14, 0x14, 0x08,  // p
+		0x08, 0x14, 0x14, 0x18, 0x7C,  // q
+		0x7C, 0x08, 0x04, 0x04, 0x08,  // r
+		0x48, 0x54, 0x54, 0x54, 0x20,  // s
+		0x04, 0x3F, 0x44, 0x40, 0x20,  // t
+		0x3C, 0x40, 0x40, 0x20, 0x7C,  // u
+		0x1C, 0x20, 0x40, 0x20, 0x1C,  // v
+		0x3C, 0x40, 0x30, 0x40, 0x3C,  // w
+		0x44, 0x28, 0x10, 0x28, 0x44,  // x
+		0x0C, 0x50, 0x50, 0x50, 0x3C,  // y
+		0x44, 0x64, 0x54, 0x4C, 0x44,  // z
+		0x00, 0x08, 0x36, 0x41, 0x00,  // {
+		0x00, 0x00, 0x7F, 0x00, 0x00,  // |
+		0x00, 0x41, 0x36, 0x08, 0x00,  // }
+		0x08, 0x04, 0x08, 0x10, 0x08,  // ~
+	};
 
-	void Point::Paint() { window_->DrawPoint(color_, rect_.x, rect_.y); }
+	const int GlyphAtlas::kGlyphsPerRow;
+
+	GlyphAtlas::GlyphAtlas(const BitmapFont& font) : font_(font) {
+		int rows = (font.count + kGlyphsPerRow - 1) / kGlyphsPerRow;
+		width_ = std::min(font.count, kGlyphsPerRow) * (font.width + 1) + 1;
+		height_ = rows * (font.height + 1) + 1;
+		coverage_.assign((size_t)width_ * height_, 0);
+		glyphs_.resize(font.count);
+		for (int i = 0; i < font.count; i++) {
+			SDL_Rect& glyph = glyphs_[i];
+			glyph = SDL_Rect{ 1 + i % kGlyphsPerRow * (font.width + 1),
+				1 + i / kGlyphsPerRow * (font.height + 1), font.width, font.height };
+			const Uint8* columns = font.columns + (size_t)i * font.width;
+			for (int x = 0; x < font.width; x++)
+				for (int y = 0; y < font.height; y++)
+					if (columns[x] & (1 << y))
+						coverage_[(size_t)(glyph.y + y) * width_ + glyph.x + x] = 255;
+		}
+	}
+
+	const GlyphAtlas& GlyphAtlas::BuiltIn() {
+		static const GlyphAtlas atlas(BitmapFont{ 5, 7, ' ', 95, kBuiltInGlyphs });
+		return atlas;
+	}
+
+	int GlyphAtlas::GetWidth() const { return width_; }
+
+	int GlyphAtlas::GetHeight() const { return height_; }
+
+	const Uint8* GlyphAtlas::GetCoverage() const { return coverage_.data(); }
+
+	SDL_Point GlyphAtlas::Layout(const string& text, int scale, vector<GlyphQuad>& quads) const {
+		int advance = (font_.width + 1) * scale, line_height = (font_.height + 1) * scale;
+		int x = 0, y = 0, width = 0;
+		for (char c : text) {
+			if (c == '\n') {
+				x = 0;
+				y += line_height;
+				continue;
+			}
+			int glyph = (unsigned char)c - font_.first;
+			if (glyph < 0 || glyph >= font_.count)
+				glyph = '?' - font_.first;
+			// Blank glyphs only advance
+			if (glyph >= 0 && glyph < font_.count) {
+				const Uint8* columns = font_.columns + (size_t)glyph * font_.width;
+				if (std::any_of(columns, columns + font_.width, [](Uint8 column) { return column != 0; }))
+					quads.push_back(GlyphQuad{ glyphs_[glyph],
+						SDL_Rect{ x, y, font_.width * scale, font_.height * scale } });
+			}
+			x += advance;
+			width = std::max(width, x - scale);
+		}
+		int height = text.empty() ? 0 : y + line_height - scale;
+		return SDL_Point{ width, height };
+	}
 
 	//------------------------------------------------------//
 	//------------------------------------------------------//
 	//------------------------------------------------------//
 
-	//--------------RECTANGLE CLASS-------------------------//
+	//--------------SPRITE ATLAS CLASS----------------------//
 	//------------------------------------------------------//
 	//------------------------------------------------------//
 	//------------------------------------------------------//
 
-	Rectangle::Rectangle(ObjectWindow* window, Color color, int x, int y, int width,
-		int height)
-		: GraphicalObject(window, color) {
-		rect_.x = x;
-		rect_.y = y;
-		rect_.w = width;
-		rect_.h = height;
+	const int SpriteAtlas::kDefaultPageSize;
+
+	SpriteAtlas::SpriteAtlas(int page_size) : page_size_(std::max(page_size, 2)) {}
+
+	SpriteAtlas::~SpriteAtlas() { Clear(); }
+
+	int SpriteAtlas::Allocate(int width, int height, SDL_Rect& rect) {
+		// Each image keeps a pixel free to its right and below it, and the
+		// first row and column of a page stay free too
+		int padded_width = width + 1, padded_height = height + 1;
+		int page_index = -1;
+		Shelf* best = nullptr;
+		if (padded_width + 1 <= page_size_ && padded_height + 1 <= page_size_) {
+			for (size_t p = 0; p < pages_.size(); p++) {
+				Page& page = pages_[p];
+				for (Shelf& shelf : page.shelves)
+					if (padded_height <= shelf.height && shelf.used + padded_width <= page.width &&
+						(!best || shelf.height < best->height)) {
+						best = &shelf;
+						page_index = (int)p;
+					}
+			}
+			if (!best)
+				for (size_t p = 0; p < pages_.size() && !best; p++) {
+					Page& page = pages_[p];
+					if (page.width == page_size_ && page.used_height + padded_height <= page.height) {
+						page.shelves.push_back(Shelf{ page.used_height, padded_height, 1 });
+						page.used_height += padded_height;
+						best = &page.shelves.back();
+						page_index = (int)p;
+					}
+				}
+		}
+		if (!best) {
+			// A new page, sized to fit an image larger than the usual page
+			int page_width = std::max(page_size_, padded_width + 1);
+			int page_height = std::max(page_size_, padded_height + 1);
+			pages_.push_back(Page{ page_width, page_height,
+				vector<Uint32>((size_t)page_width * page_height, 0), vector<Shelf>(), 1, nullptr, true });
+			Page& page = pages_.back();
+			page.shelves.push_back(Shelf{ 1, padded_height, 1 });
+			page.used_height += padded_height;
+			best = &page.shelves.back();
+			page_index = (int)pages_.size() - 1;
+		}
+		rect = SDL_Rect{ best->used, best->y, width, height };
+		best->used += padded_width;
+		return page_index;
 	}
 
-	Rectangle::Rectangle(ObjectWindow * window, Color color, int x, int y, int width, int height, bool filled) : GraphicalObject(window, color, filled)
-	{
-		rect_.x = x;
-		rect_.y = y;
-		rect_.w = width;
-		rect_.h = height;
+	SpriteImage SpriteAtlas::Add(const Uint32* pixels, int width, int height, int pitch) {
+		if (width <= 0 || height <= 0)
+			return SpriteImage{ -1, SDL_Rect{ 0, 0, 0, 0 } };
+		SDL_Rect rect;
+		int page_index = Allocate(width, height, rect);
+		Page& page = pages_[page_index];
+		for (int row = 0; row < height; row++)
+			std::copy_n((const Uint32*)((const Uint8*)pixels + (size_t)row * pitch), width,
+				&page.pixels[(size_t)(rect.y + row) * page.width + rect.x]);
+		page.dirty = true;
+		return SpriteImage{ page_index, rect };
 	}
 
-	void Rectangle::Paint() {
-		if (filled_)
-			window_->DrawFilledRectangle(color_, rect_);
-		else
-			window_->DrawRectangle(color_, rect_);
+	SpriteImage SpriteAtlas::LoadBmp(const string& path) {
+		SpriteImage image{ -1, SDL_Rect{ 0, 0, 0, 0 } };
+		SDL_Surface* loaded = SDL_LoadBMP(path.c_str());
+		if (!loaded)
+			return image;
+		SDL_Surface* converted = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_ARGB8888, 0);
+		SDL_FreeSurface(loaded);
+		if (!converted)
+			return image;
+		if (SDL_LockSurface(converted) == 0) {
+			image = Add((const Uint32*)converted->pixels, converted->w, converted->h, converted->pitch);
+			SDL_UnlockSurface(converted);
+		}
+		SDL_FreeSurface(converted);
+		return image;
+	}
+
+	int SpriteAtlas::GetPageCount() const { return (int)pages_.size(); }
+
+	int SpriteAtlas::GetPageWidth(int page) const { return pages_[page].width; }
+
+	int SpriteAtlas::GetPageHeight(int page) const { return pages_[page].height; }
+
+	const Uint32* SpriteAtlas::GetPixels(int page) const { return pages_[page].pixels.data(); }
+
+	SDL_Texture* SpriteAtlas::GetTexture(SDL_Renderer* renderer, int page_index) {
+		if (page_index < 0 || page_index >= (int)pages_.size())
+			return nullptr;
+		Page& page = pages_[page_index];
+		if (!page.texture) {
+			page.texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+				SDL_TEXTUREACCESS_STATIC, page.width, page.height);
+			if (!page.texture)
+				return nullptr;
+			SDL_SetTextureBlendMode(page.texture, SDL_BLENDMODE_BLEND);
+			page.dirty = true;
+		}
+		if (page.dirty) {
+			SDL_UpdateTexture(page.texture, nullptr, page.pixels.data(), page.width * 4);
+			page.dirty = false;
+		}
+		return page.texture;
 	}
 
+	void SpriteAtlas::Clear() {
+		for (Page& page : pages_)
+			if (page.texture)
+				SDL_DestroyTexture(page.texture);
+		pages_.clear();
+	}
 
 	//------------------------------------------------------//
 	//------------------------------------------------------//
 	//------------------------------------------------------//
 
-	//--------------CIRCLE CLASS----------------------------//
+	//--------------FRAME PROFILER CLASS--------------------//
 	//------------------------------------------------------//
 	//------------------------------------------------------//
 	//------------------------------------------------------//
 
-	Circle::Circle(ObjectWindow* window, Color color, int x, int y, int radius) : GraphicalObject(window, color, x, y)
-	{
-		rect_.w = radius * 2;
-		rect_.h = radius * 2;
+	const size_t FrameProfiler::kHistoryFrames;
+
+	static double SecondsSince(Uint64 start) {
+		return (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
 	}
 
-	Circle::Circle(ObjectWindow * window, Color color, int x, int y, int radius, bool filled) : GraphicalObject(window, color, filled)
-	{
-		rect_.x = x;
-		rect_.y = y;
-		rect_.w = radius * 2;
-		rect_.h = radius * 2;
+	FrameProfiler::FrameProfiler()
+		: next_(0), frames_(0), current_(), dump_(nullptr, fclose) {
+		history_.reserve(kHistoryFrames);
 	}
 
-	void Circle::SetRadius(int radius)
-	{
-		rect_.w = radius * 2;
-		rect_.h = radius * 2;
+	void FrameProfiler::Add(FrameMetric metric, double value) {
+		current_.values[(int)metric] += value;
 	}
 
-	void Circle::Paint()
-	{
-		int radius = rect_.w / 2;
-		if (filled_)
-			window_->DrawFilledCircle(color_, rect_.x + radius, rect_.y + radius, radius);
-		else
-			window_->DrawCircle(color_, rect_.x + radius, rect_.y + radius, radius);
+	double FrameProfiler::Current(FrameMetric metric) const {
+		return current_.values[(int)metric];
 	}
 
-	//------------------------------------------------------//
-	//------------------------------------------------------//
-	//------------------------------------------------------//
+	void FrameProfiler::EndFrame() {
+		if (history_.size() < kHistoryFrames)
+			history_.push_back(current_);
+		else
+			history_[next_] = current_;
+		next_ = (next_ + 1) % kHistoryFrames;
 
-	//--------------OBJECT WINDOW CLASS---------------------//
-	//------------------------------------------------------//
-	//------------------------------------------------------//
-	//------------------------------------------------------//
+		if (dump_) {
+			fprintf(dump_.get(), "%lu", frames_);
+			for (int i = 0; i < (int)FrameMetric::kCount; i++)
+				fprintf(dump_.get(), ",%.9g", current_.values[i]);
+			fputc('\n', dump_.get());
+		}
+		frames_++;
+		current_ = FrameSample();
+	}
 
-	ObjectWindow::ObjectWindow(const string& title, int width, int height,
-		const Color& background)
-		: Window(title, width, height, background) {}
+	MetricSummary FrameProfiler::Summarize(FrameMetric metric) const {
+		MetricSummary summary = MetricSummary();
+		if (history_.empty())
+			return summary;
+		vector<double> values;
+		values.reserve(history_.size());
+		for (const FrameSample& sample : history_)
+			values.push_back(sample.values[(int)metric]);
+		std::sort(values.begin(), values.end());
 
-	void ObjectWindow::PrePaint() { Window::PrePaint(); }
+		double total = 0.0;
+		for (double value : values)
+			total += value;
+		summary.min = values.front();
+		summary.max = values.back();
+		summary.average = total / values.size();
+		// Nearest rank: the smallest value at least 99% of the frames reach
+		size_t rank = (values.size() * 99 + 99) / 100;
+		summary.p99 = values[rank - 1];
+		return summary;
+	}
 
-	void ObjectWindow::Paint() {}
+	size_t FrameProfiler::Size() const { return history_.size(); }
 
-	void ObjectWindow::PostPaint() {
-		for (auto& o : objects_) o->Paint();
-		Window::PostPaint();
+	const FrameSample& FrameProfiler::At(size_t index) const {
+		if (history_.size() < kHistoryFrames)
+			return history_[index];
+		return history_[(next_ + index) % kHistoryFrames];
 	}
 
-	void ObjectWindow::Add(GraphicalObject* obj) { objects_.push_back(obj); }
+	unsigned long FrameProfiler::GetFrameCount() const { return frames_; }
 
-	void ObjectWindow::Remove(GraphicalObject * obj)
-	{
-		objects_.erase(std::remove(objects_.begin(), objects_.end(), obj), objects_.end());
+	void FrameProfiler::Reset() {
+		history_.clear();
+		next_ = 0;
+		frames_ = 0;
+		current_ = FrameSample();
 	}
 
-	GraphicalObject* ObjectWindow::GetFirstHit(int x, int y)
-	{
-		for (GraphicalObject* o : objects_)
-		{
-			if (o->Hit(x, y))
-				return o;
+	bool FrameProfiler::SetDumpFile(const string& path) {
+		dump_.reset();
+		if (path.empty())
+			return true;
+		dump_.reset(fopen(path.c_str(), "w"));
+		if (!dump_)
+			return false;
+		fputs("frame", dump_.get());
+		for (int i = 0; i < (int)FrameMetric::kCount; i++)
+			fprintf(dump_.get(), ",%s", MetricName((FrameMetric)i));
+		fputc('\n', dump_.get());
+		return true;
+	}
+
+	const char* FrameProfiler::MetricName(FrameMetric metric) {
+		switch (metric) {
+		case FrameMetric::kEventSeconds: return "events_s";
+		case FrameMetric::kUpdateSeconds: return "update_s";
+		case FrameMetric::kPrePaintSeconds: return "prepaint_s";
+		case FrameMetric::kPaintSeconds: return "paint_s";
+		case FrameMetric::kPostPaintSeconds: return "postpaint_s";
+		case FrameMetric::kPresentSeconds: return "present_s";
+		case FrameMetric::kWorkSeconds: return "work_s";
+		case FrameMetric::kDrawCalls: return "draw_calls";
+		case FrameMetric::kStateChanges: return "state_changes";
+		case FrameMetric::kObjectsPainted: return "objects_painted";
+		case FrameMetric::kEventsHandled: return "events_handled";
+		default: return "";
 		}
-		return nullptr;
+	}
+
+	//--------------SOFTWARE RASTERIZER CLASS---------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	// Implements Bresenham's circle generation algorithm to find the rim
+	// from 90 degrees to 45 degrees and reflects each point across the
+	// eight octants, like Window::EightOcts.
+	// (x, y) is the circle's center.
+	// Adapted from 
+	// Computer Graphics: The Principles behind the Art and Science
+	// Cornel Pokorny and Curtis Gerald (c) 1989
+	static void AppendCircleRim(vector<SDL_Point>& points, int x, int y, int radius) {
+		auto eight_octs = [&](int edge_x, int edge_y) {
+			points.push_back(SDL_Point{ edge_x + x, edge_y + y });
+			points.push_back(SDL_Point{ -edge_x + x, edge_y + y });
+			points.push_back(SDL_Point{ edge_x + x, -edge_y + y });
+			points.push_back(SDL_Point{ -edge_x + x, -edge_y + y });
+			points.push_back(SDL_Point{ edge_y + x, edge_x + y });
+			points.push_back(SDL_Point{ -edge_y + x, edge_x + y });
+			points.push_back(SDL_Point{ edge_y + x, -edge_x + y });
+			points.push_back(SDL_Point{ -edge_y + x, -edge_x + y });
+		};
+
+		// Start at 90 degrees
+		int current_x = 0, current_y = radius, s = 3 - 2 * radius;
+		while (current_x < current_y) {  // Stop at 45 degrees
+			eight_octs(current_x, current_y);
+			if (s <= 0)
+				s = s + 4 * current_x + 6;
+			else {
+				s = s + 4 * (current_x - current_y) + 10;
+				current_y--;
+			}
+			current_x++;
+		}
+		if (current_x == current_y)
+			eight_octs(current_x, current_y);
+	}
+
+	// Appends the rows of a filled ellipse centered at (x, y) to spans.
+	// Walks the rows outward from the center while shrinking the half-width,
+	// so each row's extent is found with O(1) amortized work instead of
+	// testing every pixel of the bounding box.  Rows of equal width are
+	// merged into a single taller rect.
+	static void AppendEllipseRows(vector<SDL_Rect>& spans, int x, int y, int radius_x, int radius_y) {
+		if (radius_x < 0 || radius_y < 0)
+			return;
+		long long rx2 = (long long)radius_x * radius_x;
+		long long ry2 = (long long)radius_y * radius_y;
+		int half_width = radius_x, last_half_width = -1;
+		size_t top = 0, bottom = 0;
+		for (int edge_y = 0; edge_y <= radius_y; edge_y++) {
+			while (half_width > 0 && (long long)half_width * half_width * ry2
+				+ (long long)edge_y * edge_y * rx2 > rx2 * ry2)
+				half_width--;
+			if (edge_y == 0) {
+				spans.push_back(SDL_Rect{ x - half_width, y, 2 * half_width + 1, 1 });
+				top = bottom = spans.size() - 1;
+			}
+			else if (half_width == last_half_width) {
+				spans[top].y--;
+				spans[top].h++;
+				spans[bottom].h++;
+			}
+			else {
+				spans.push_back(SDL_Rect{ x - half_width, y - edge_y, 2 * half_width + 1, 1 });
+				top = spans.size() - 1;
+				spans.push_back(SDL_Rect{ x - half_width, y + edge_y, 2 * half_width + 1, 1 });
+				bottom = spans.size() - 1;
+			}
+			last_half_width = half_width;
+		}
+	}
+
+	// Divides by 255 with rounding, exactly, for t up to 255 * 255
+	static inline Uint32 Div255(Uint32 t) {
+		t += 128;
+		return (t + (t >> 8)) >> 8;
+	}
+
+	// Source-over: every channel becomes (s * a + d * (255 - a)) / 255.
+	// The destination alpha is blended toward 255, which gives the usual
+	// a + d * (255 - a) / 255.  The SIMD paths compute the same expression.
+	static inline Uint32 BlendPixel(Uint32 dst, Color color) {
+		Uint32 a = color.GetAlpha(), inverse = 255 - a;
+		return (Div255(255 * a + (dst >> 24) * inverse) << 24) |
+			(Div255(color.GetRed() * a + ((dst >> 16) & 0xFF) * inverse) << 16) |
+			(Div255(color.GetGreen() * a + ((dst >> 8) & 0xFF) * inverse) << 8) |
+			Div255(color.GetBlue() * a + (dst & 0xFF) * inverse);
+	}
+
+	SoftwareRasterizer::SoftwareRasterizer()
+		: width_(0), height_(0), clip_{ 0, 0, 0, 0 } {}
+
+	void SoftwareRasterizer::Resize(int width, int height) {
+		width_ = std::max(width, 0);
+		height_ = std::max(height, 0);
+		pixels_.assign((size_t)width_ * height_, 0);
+		SetClipRect(nullptr);
+	}
+
+	int SoftwareRasterizer::GetWidth() const { return width_; }
+
+	int SoftwareRasterizer::GetHeight() const { return height_; }
+
+	const Uint32* SoftwareRasterizer::GetPixels() const { return pixels_.data(); }
+
+	int SoftwareRasterizer::GetPitch() const { return width_ * 4; }
+
+	void SoftwareRasterizer::SetClipRect(const SDL_Rect* rect) {
+		clip_ = SDL_Rect{ 0, 0, width_, height_ };
+		if (!rect)
+			return;
+		int left = std::max(rect->x, 0), top = std::max(rect->y, 0);
+		int right = std::min(rect->x + rect->w, width_);
+		int bottom = std::min(rect->y + rect->h, height_);
+		clip_ = SDL_Rect{ left, top, std::max(right - left, 0), std::max(bottom - top, 0) };
+	}
+
+	void SoftwareRasterizer::FillSpan(Uint32* row, int count, Color color, bool blend) {
+		int i = 0;
+		if (!blend || color.GetAlpha() == 255) {
+			Uint32 value = color.GetArgb();
+#if SGL2_AVX2
+			__m256i value8 = _mm256_set1_epi32((int)value);
+			for (; i + 8 <= count; i += 8)
+				_mm256_storeu_si256((__m256i*)(row + i), value8);
+#endif
+#if SGL2_SSE2
+			__m128i value4 = _mm_set1_epi32((int)value);
+			for (; i + 4 <= count; i += 4)
+				_mm_storeu_si128((__m128i*)(row + i), value4);
+#endif
+			for (; i < count; i++)
+				row[i] = value;
+			return;
+		}
+		if (color.GetAlpha() == 0)
+			return;
+
+#if SGL2_SSE2
+		// Pixels are widened to 16 bits a channel, in memory order B, G,
+		// R, A; the source terms are premultiplied once for the whole span
+		short a = color.GetAlpha();
+		short inverse = (short)(255 - a);
+		short source_b = (short)(color.GetBlue() * a), source_g = (short)(color.GetGreen() * a);
+		short source_r = (short)(color.GetRed() * a), source_a = (short)(255 * a);
+#endif
+#if SGL2_AVX2
+		{
+			__m256i zero = _mm256_setzero_si256();
+			__m256i weight = _mm256_set1_epi16(inverse);
+			__m256i bias = _mm256_set1_epi16(128);
+			__m256i source = _mm256_set_epi16(source_a, source_r, source_g, source_b,
+				source_a, source_r, source_g, source_b, source_a, source_r, source_g, source_b,
+				source_a, source_r, source_g, source_b);
+			for (; i + 8 <= count; i += 8) {
+				__m256i dst = _mm256_loadu_si256((const __m256i*)(row + i));
+				__m256i low = _mm256_unpacklo_epi8(dst, zero);
+				__m256i high = _mm256_unpackhi_epi8(dst, zero);
+				low = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(low, weight), source), bias);
+				high = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(high, weight), source), bias);
+				low = _mm256_srli_epi16(_mm256_add_epi16(low, _mm256_srli_epi16(low, 8)), 8);
+				high = _mm256_srli_epi16(_mm256_add_epi16(high, _mm256_srli_epi16(high, 8)), 8);
+				_mm256_storeu_si256((__m256i*)(row + i), _mm256_packus_epi16(low, high));
+			}
+		}
+#endif
+#if SGL2_SSE2
+		{
+			__m128i zero = _mm_setzero_si128();
+			__m128i weight = _mm_set1_epi16(inverse);
+			__m128i bias = _mm_set1_epi16(128);
+			__m128i source = _mm_set_epi16(source_a, source_r, source_g, source_b,
+				source_a, source_r, source_g, source_b);
+			for (; i + 4 <= count; i += 4) {
+				__m128i dst = _mm_loadu_si128((const __m128i*)(row + i));
+				__m128i low = _mm_unpacklo_epi8(dst, zero);
+				__m128i high = _mm_unpackhi_epi8(dst, zero);
+				low = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(low, weight), source), bias);
+				high = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(high, weight), source), bias);
+				low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+				high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+				_mm_storeu_si128((__m128i*)(row + i), _mm_packus_epi16(low, high));
+			}
+		}
+#endif
+		for (; i < count; i++)
+			row[i] = BlendPixel(row[i], color);
+	}
+
+	void SoftwareRasterizer::FillRectsClipped(const SDL_Rect* rects, size_t count,
+		Color color, bool blend, const SDL_Rect& clip) {
+		for (size_t i = 0; i < count; i++) {
+			int left = std::max(rects[i].x, clip.x);
+			int top = std::max(rects[i].y, clip.y);
+			int right = std::min(rects[i].x + rects[i].w, clip.x + clip.w);
+			int bottom = std::min(rects[i].y + rects[i].h, clip.y + clip.h);
+			if (left >= right)
+				continue;
+			for (int y = top; y < bottom; y++)
+				FillSpan(&pixels_[(size_t)y * width_ + left], right - left, color, blend);
+		}
+	}
+
+	void SoftwareRasterizer::Clear(Color color) {
+		if (!pixels_.empty())
+			FillSpan(pixels_.data(), (int)pixels_.size(), color, false);
+	}
+
+	void SoftwareRasterizer::ClearRects(const SDL_Rect* rects, size_t count, Color color) {
+		FillRectsClipped(rects, count, color, false, clip_);
+	}
+
+	void SoftwareRasterizer::FillRects(const SDL_Rect* rects, size_t count, Color color) {
+		FillRectsClipped(rects, count, color, true, clip_);
+	}
+
+	void SoftwareRasterizer::DrawRects(const SDL_Rect* rects, size_t count, Color color) {
+		DrawRectsClipped(rects, count, color, clip_);
+	}
+
+	void SoftwareRasterizer::DrawPoints(const SDL_Point* points, size_t count, Color color) {
+		DrawPointsClipped(points, count, color, clip_);
+	}
+
+	void SoftwareRasterizer::DrawRectsClipped(const SDL_Rect* rects, size_t count,
+		Color color, const SDL_Rect& clip) {
+		for (size_t i = 0; i < count; i++) {
+			const SDL_Rect& r = rects[i];
+			if (r.w <= 0 || r.h <= 0)
+				continue;
+			// The top and bottom rows, then the sides between them
+			SDL_Rect edges[4] = {
+				{ r.x, r.y, r.w, 1 },
+				{ r.x, r.y + r.h - 1, r.w, r.h > 1 ? 1 : 0 },
+				{ r.x, r.y + 1, 1, r.h - 2 },
+				{ r.x + r.w - 1, r.y + 1, r.w > 1 ? 1 : 0, r.h - 2 }
+			};
+			FillRectsClipped(edges, 4, color, true, clip);
+		}
+	}
+
+	void SoftwareRasterizer::DrawPointsClipped(const SDL_Point* points, size_t count,
+		Color color, const SDL_Rect& clip) {
+		if (color.GetAlpha() == 0)
+			return;
+		Uint32 value = color.GetArgb();
+		int right = clip.x + clip.w, bottom = clip.y + clip.h;
+		for (size_t i = 0; i < count; i++) {
+			int x = points[i].x, y = points[i].y;
+			if (x < clip.x || x >= right || y < clip.y || y >= bottom)
+				continue;
+			Uint32& pixel = pixels_[(size_t)y * width_ + x];
+			pixel = color.GetAlpha() == 255 ? value : BlendPixel(pixel, color);
+		}
+	}
+
+	void SoftwareRasterizer::DrawLines(const SDL_Point* points, size_t count, Color color) {
+		DrawLinesClipped(points, count, color, clip_);
+	}
+
+	void SoftwareRasterizer::DrawLinesClipped(const SDL_Point* points, size_t count,
+		Color color, const SDL_Rect& clip) {
+		if (count < 2 || color.GetAlpha() == 0)
+			return;
+		Uint32 value = color.GetArgb();
+		int right = clip.x + clip.w, bottom = clip.y + clip.h;
+		auto plot = [&](int x, int y) {
+			if (x < clip.x || x >= right || y < clip.y || y >= bottom)
+				return;
+			Uint32& pixel = pixels_[(size_t)y * width_ + x];
+			pixel = color.GetAlpha() == 255 ? value : BlendPixel(pixel, color);
+		};
+
+		// Every line stops short of its end, where the next one starts; the
+		// last draws its end too, unless that is the first point again
+		for (size_t i = 0; i + 1 < count; i++) {
+			int x = points[i].x, y = points[i].y;
+			int end_x = points[i + 1].x, end_y = points[i + 1].y;
+			if (std::max(x, end_x) < clip.x || std::min(x, end_x) >= right ||
+				std::max(y, end_y) < clip.y || std::min(y, end_y) >= bottom)
+				continue;
+			int dx = std::abs(end_x - x), step_x = x < end_x ? 1 : -1;
+			int dy = -std::abs(end_y - y), step_y = y < end_y ? 1 : -1;
+			int error = dx + dy;
+			while (x != end_x || y != end_y) {
+				plot(x, y);
+				int error2 = 2 * error;
+				if (error2 >= dy) {
+					error += dy;
+					x += step_x;
+				}
+				if (error2 <= dx) {
+					error += dx;
+					y += step_y;
+				}
+			}
+		}
+		const SDL_Point& last = points[count - 1];
+		if (count == 2 || last.x != points[0].x || last.y != points[0].y)
+			plot(last.x, last.y);
+	}
+
+	void SoftwareRasterizer::DrawGlyphs(const GlyphAtlas& atlas, const GlyphQuad* glyphs, size_t count,
+		Color color) {
+		DrawGlyphsClipped(atlas, glyphs, count, color, clip_);
+	}
+
+	void SoftwareRasterizer::DrawGlyphsClipped(const GlyphAtlas& atlas, const GlyphQuad* glyphs,
+		size_t count, Color color, const SDL_Rect& clip) {
+		if (color.GetAlpha() == 0)
+			return;
+		const Uint8* coverage = atlas.GetCoverage();
+		for (size_t i = 0; i < count; i++) {
+			const SDL_Rect& source = glyphs[i].source;
+			const SDL_Rect& dest = glyphs[i].dest;
+			if (dest.w <= 0 || dest.h <= 0)
+				continue;
+			int left = std::max(dest.x, clip.x), right = std::min(dest.x + dest.w, clip.x + clip.w);
+			int top = std::max(dest.y, clip.y), bottom = std::min(dest.y + dest.h, clip.y + clip.h);
+			for (int y = top; y < bottom; y++) {
+				const Uint8* source_row = coverage +
+					(size_t)(source.y + (y - dest.y) * source.h / dest.h) * atlas.GetWidth();
+				Uint32* row = &pixels_[(size_t)y * width_];
+				// Covered runs are filled as spans
+				int run = left;
+				for (int x = left; x <= right; x++) {
+					bool covered = x < right && source_row[source.x + (x - dest.x) * source.w / dest.w];
+					if (covered)
+						continue;
+					if (x > run)
+						FillSpan(row + run, x - run, color, true);
+					run = x + 1;
+				}
+			}
+		}
+	}
+
+	void SoftwareRasterizer::DrawSprites(const SpriteAtlas& atlas, const SpriteQuad* sprites, size_t count) {
+		DrawSpritesClipped(atlas, sprites, count, clip_);
+	}
+
+	void SoftwareRasterizer::DrawSpritesClipped(const SpriteAtlas& atlas, const SpriteQuad* sprites,
+		size_t count, const SDL_Rect& clip) {
+		for (size_t i = 0; i < count; i++) {
+			const SDL_Rect& source = sprites[i].source;
+			const SDL_Rect& dest = sprites[i].dest;
+			Color tint = sprites[i].tint;
+			if (dest.w <= 0 || dest.h <= 0 || tint.GetAlpha() == 0)
+				continue;
+			const Uint32* page = atlas.GetPixels(sprites[i].page);
+			int page_width = atlas.GetPageWidth(sprites[i].page);
+			bool tinted = tint != Color::kWhite;
+			int left = std::max(dest.x, clip.x), right = std::min(dest.x + dest.w, clip.x + clip.w);
+			int top = std::max(dest.y, clip.y), bottom = std::min(dest.y + dest.h, clip.y + clip.h);
+			for (int y = top; y < bottom; y++) {
+				const Uint32* source_row = page +
+					(size_t)(source.y + (y - dest.y) * source.h / dest.h) * page_width;
+				Uint32* row = &pixels_[(size_t)y * width_];
+				for (int x = left; x < right; x++) {
+					Uint32 pixel = source_row[source.x + (x - dest.x) * source.w / dest.w];
+					// Modulated like SDL_SetTextureColorMod and AlphaMod
+					Uint32 a = pixel >> 24, r = (pixel >> 16) & 0xFF, g = (pixel >> 8) & 0xFF, b = pixel & 0xFF;
+					if (tinted) {
+						a = a * tint.GetAlpha() / 255;
+						r = r * tint.GetRed() / 255;
+						g = g * tint.GetGreen() / 255;
+						b = b * tint.GetBlue() / 255;
+					}
+					if (a == 255)
+						row[x] = 0xFF000000 | (r << 16) | (g << 8) | b;
+					else if (a != 0)
+						row[x] = BlendPixel(row[x], Color((Uint8)r, (Uint8)g, (Uint8)b, (Uint8)a));
+				}
+			}
+		}
+	}
+
+	void SoftwareRasterizer::RasterizeCommand(const DrawCommand& command, const DrawList& list,
+		const GlyphAtlas& font, const SpriteAtlas& sprites, const SDL_Rect& clip,
+		vector<SDL_Rect>& spans, vector<SDL_Point>& points) {
+		int left = std::max(clip.x, 0), top = std::max(clip.y, 0);
+		int right = std::min(clip.x + clip.w, width_);
+		int bottom = std::min(clip.y + clip.h, height_);
+		if (left >= right || top >= bottom)
+			return;
+		SDL_Rect area{ left, top, right - left, bottom - top };
+
+		const SDL_Rect& rect = command.rect;
+		int radius = rect.w / 2;
+		switch (command.kind) {
+		case DrawKind::kPoint: {
+			SDL_Point point{ rect.x, rect.y };
+			DrawPointsClipped(&point, 1, command.color, area);
+			break;
+		}
+		case DrawKind::kRectangle:
+			DrawRectsClipped(&rect, 1, command.color, area);
+			break;
+		case DrawKind::kFilledRectangle:
+			FillRectsClipped(&rect, 1, command.color, true, area);
+			break;
+		case DrawKind::kCircle:
+			points.clear();
+			AppendCircleRim(points, rect.x + radius, rect.y + rect.h / 2, radius);
+			DrawPointsClipped(points.data(), points.size(), command.color, area);
+			break;
+		case DrawKind::kFilledCircle:
+			spans.clear();
+			AppendEllipseRows(spans, rect.x + radius, rect.y + rect.h / 2, radius, rect.h / 2);
+			FillRectsClipped(spans.data(), spans.size(), command.color, true, area);
+			break;
+		case DrawKind::kPolyline:
+			DrawLinesClipped(list.Vertices().data() + command.first_item, command.item_count,
+				command.color, area);
+			break;
+		case DrawKind::kText:
+			DrawGlyphsClipped(font, list.Glyphs().data() + command.first_item, command.item_count,
+				command.color, area);
+			break;
+		case DrawKind::kSprite:
+			DrawSpritesClipped(sprites, list.Sprites().data() + command.first_item, command.item_count,
+				area);
+			break;
+		}
+	}
+
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	//--------------WORKER POOL CLASS-----------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	WorkerPool::WorkerPool(unsigned threads) : shared_(new Shared()) {
+		shared_->job = nullptr;
+		shared_->count = 0;
+		shared_->next = 0;
+		shared_->busy = 0;
+		shared_->generation = 0;
+		shared_->stopping = false;
+		for (unsigned thread = 1; thread < std::max(threads, 1u); thread++)
+			threads_.emplace_back(WorkerMain, shared_.get(), thread);
+	}
+
+	WorkerPool::~WorkerPool() {
+		{
+			std::lock_guard<std::mutex> lock(shared_->mutex);
+			shared_->stopping = true;
+		}
+		shared_->wake.notify_all();
+		for (std::thread& thread : threads_)
+			thread.join();
+	}
+
+	unsigned WorkerPool::GetThreadCount() const { return (unsigned)threads_.size() + 1; }
+
+	void WorkerPool::Work(Shared& shared, unsigned thread) {
+		for (size_t i = shared.next++; i < shared.count; i = shared.next++)
+			(*shared.job)(i, thread);
+	}
+
+	void WorkerPool::WorkerMain(Shared* shared, unsigned thread) {
+		unsigned long seen = 0;
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> lock(shared->mutex);
+				shared->wake.wait(lock, [&] { return shared->stopping || shared->generation != seen; });
+				if (shared->stopping)
+					return;
+				seen = shared->generation;
+			}
+			Work(*shared, thread);
+			std::lock_guard<std::mutex> lock(shared->mutex);
+			if (--shared->busy == 0)
+				shared->done.notify_one();
+		}
+	}
+
+	void WorkerPool::ParallelFor(size_t count, const std::function<void(size_t, unsigned)>& job) {
+		if (threads_.empty() || count < 2) {
+			for (size_t i = 0; i < count; i++)
+				job(i, 0);
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(shared_->mutex);
+			shared_->job = &job;
+			shared_->count = count;
+			shared_->next = 0;
+			shared_->busy = (unsigned)threads_.size();
+			shared_->generation++;
+		}
+		shared_->wake.notify_all();
+		Work(*shared_, 0);
+		std::unique_lock<std::mutex> lock(shared_->mutex);
+		shared_->done.wait(lock, [&] { return shared_->busy == 0; });
+		shared_->job = nullptr;
+	}
+
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	//--------------FRAME RECORDER CLASS--------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	const size_t FrameRecorder::kDefaultBuffers;
+	const size_t FrameRecorder::kNoBuffer;
+
+	FrameRecorder::FrameRecorder()
+		: shared_(new Shared()), format_(CaptureFormat::kRaw), policy_(CaptureDropPolicy::kDropOldest),
+		width_(0), height_(0), stream_(nullptr, fclose), filling_(kNoBuffer) {
+		shared_->head = 0;
+		shared_->queued = 0;
+		shared_->stats = CaptureStats();
+		shared_->stopping = false;
+	}
+
+	FrameRecorder::~FrameRecorder() { Stop(); }
+
+	bool FrameRecorder::Start(const string& path, CaptureFormat format, int width, int height,
+		int fps, size_t buffers, CaptureDropPolicy policy) {
+		Stop();
+		if (width <= 0 || height <= 0)
+			return false;
+		if (format == CaptureFormat::kY4m) {
+			stream_.reset(fopen(path.c_str(), "wb"));
+			if (!stream_)
+				return false;
+			fprintf(stream_.get(), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width, height,
+				std::max(fps, 1));
+		}
+		path_ = path;
+		format_ = format;
+		policy_ = policy;
+		width_ = width;
+		height_ = height;
+		size_t count = std::max(buffers, (size_t)1);
+		Shared& shared = *shared_;
+		shared.buffers.assign(count, vector<Uint32>((size_t)width * height));
+		shared.free.clear();
+		for (size_t i = count; i > 0; i--)
+			shared.free.push_back(i - 1);
+		shared.queue.assign(count, 0);
+		shared.numbers.assign(count, 0);
+		shared.head = 0;
+		shared.queued = 0;
+		shared.stats = CaptureStats();
+		shared.stopping = false;
+		// Large enough for a frame in any format
+		encoded_.resize((size_t)width * height * 3);
+		writer_ = std::thread(&FrameRecorder::WriterMain, this);
+		return true;
+	}
+
+	void FrameRecorder::Stop() {
+		if (!writer_.joinable())
+			return;
+		if (filling_ != kNoBuffer)
+			SubmitFrame(false);
+		{
+			std::lock_guard<std::mutex> lock(shared_->mutex);
+			shared_->stopping = true;
+		}
+		shared_->wake.notify_all();
+		writer_.join();
+		stream_.reset();
+	}
+
+	bool FrameRecorder::IsRecording() const { return writer_.joinable(); }
+
+	Uint32* FrameRecorder::AcquireFrame() {
+		if (!IsRecording() || filling_ != kNoBuffer)
+			return nullptr;
+		Shared& shared = *shared_;
+		std::lock_guard<std::mutex> lock(shared.mutex);
+		unsigned long number = shared.stats.offered++;
+		if (!shared.free.empty()) {
+			filling_ = shared.free.back();
+			shared.free.pop_back();
+		}
+		else if (policy_ == CaptureDropPolicy::kDropOldest && shared.queued > 0) {
+			filling_ = shared.queue[shared.head];
+			shared.head = (shared.head + 1) % shared.queue.size();
+			shared.queued--;
+			shared.stats.dropped++;
+		}
+		else {
+			shared.stats.dropped++;
+			return nullptr;
+		}
+		shared.numbers[filling_] = number;
+		return shared.buffers[filling_].data();
+	}
+
+	void FrameRecorder::SubmitFrame(bool filled) {
+		if (filling_ == kNoBuffer)
+			return;
+		Shared& shared = *shared_;
+		{
+			std::lock_guard<std::mutex> lock(shared.mutex);
+			if (filled) {
+				shared.queue[(shared.head + shared.queued) % shared.queue.size()] = filling_;
+				shared.queued++;
+			}
+			else {
+				shared.free.push_back(filling_);
+				shared.stats.failed++;
+			}
+		}
+		filling_ = kNoBuffer;
+		if (filled)
+			shared.wake.notify_one();
+	}
+
+	CaptureStats FrameRecorder::GetStats() const {
+		std::lock_guard<std::mutex> lock(shared_->mutex);
+		return shared_->stats;
+	}
+
+	void FrameRecorder::WriterMain() {
+		Shared& shared = *shared_;
+		for (;;) {
+			size_t buffer;
+			unsigned long number;
+			{
+				std::unique_lock<std::mutex> lock(shared.mutex);
+				shared.wake.wait(lock, [&] { return shared.stopping || shared.queued > 0; });
+				if (shared.queued == 0)
+					return;
+				buffer = shared.queue[shared.head];
+				shared.head = (shared.head + 1) % shared.queue.size();
+				shared.queued--;
+				number = shared.numbers[buffer];
+			}
+			// The buffer is in neither list while it is written, so the
+			// frame loop cannot reuse it
+			bool written = WriteFrame(shared.buffers[buffer], number);
+			std::lock_guard<std::mutex> lock(shared.mutex);
+			shared.free.push_back(buffer);
+			if (written)
+				shared.stats.written++;
+			else
+				shared.stats.failed++;
+		}
+	}
+
+	bool FrameRecorder::WriteFrame(const vector<Uint32>& pixels, unsigned long number) {
+		size_t count = (size_t)width_ * height_;
+		if (format_ == CaptureFormat::kY4m) {
+			// BT.601 in video range, one plane after another
+			Uint8* y_plane = encoded_.data();
+			Uint8* u_plane = y_plane + count;
+			Uint8* v_plane = u_plane + count;
+			for (size_t i = 0; i < count; i++) {
+				int r = (pixels[i] >> 16) & 0xFF, g = (pixels[i] >> 8) & 0xFF, b = pixels[i] & 0xFF;
+				y_plane[i] = (Uint8)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+				u_plane[i] = (Uint8)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+				v_plane[i] = (Uint8)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+			}
+			FILE* file = stream_.get();
+			return fputs("FRAME\n", file) >= 0 && fwrite(encoded_.data(), 1, count * 3, file) == count * 3;
+		}
+
+		char suffix[32];
+		snprintf(suffix, sizeof(suffix), "%06lu.%s", number, format_ == CaptureFormat::kPpm ? "ppm" : "raw");
+		std::unique_ptr<FILE, int(*)(FILE*)> file(fopen((path_ + suffix).c_str(), "wb"), fclose);
+		if (!file)
+			return false;
+		if (format_ == CaptureFormat::kRaw)
+			return fwrite(pixels.data(), 4, count, file.get()) == count;
+		Uint8* rgb = encoded_.data();
+		for (size_t i = 0; i < count; i++) {
+			rgb[3 * i] = (Uint8)(pixels[i] >> 16);
+			rgb[3 * i + 1] = (Uint8)(pixels[i] >> 8);
+			rgb[3 * i + 2] = (Uint8)pixels[i];
+		}
+		return fprintf(file.get(), "P6\n%d %d\n255\n", width_, height_) > 0 &&
+			fwrite(rgb, 1, count * 3, file.get()) == count * 3;
+	}
+
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	//--------------TRIPLE BUFFER CLASS---------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	template <typename T>
+	TripleBuffer<T>::TripleBuffer() : slots_(), middle_(1), back_(0), front_(2) {}
+
+	template <typename T>
+	T& TripleBuffer<T>::Back() { return slots_[back_]; }
+
+	template <typename T>
+	void TripleBuffer<T>::Publish() {
+		// Release hands over the writes to the back slot with it
+		back_ = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel) & ~kFresh;
+	}
+
+	template <typename T>
+	bool TripleBuffer<T>::Acquire() {
+		if (!(middle_.load(std::memory_order_relaxed) & kFresh))
+			return false;
+		// The slot may have been published again since the load; either
+		// way it is the newest
+		front_ = middle_.exchange(front_, std::memory_order_acq_rel) & ~kFresh;
+		return true;
+	}
+
+	template <typename T>
+	const T& TripleBuffer<T>::Front() const { return slots_[front_]; }
+
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	//--------------SPAN CLASS------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	template <typename T>
+	Span<T>::Span() : data_(nullptr), size_(0) {}
+
+	template <typename T>
+	Span<T>::Span(T* data, size_t size) : data_(data), size_(size) {}
+
+	template <typename T>
+	template <typename U>
+	Span<T>::Span(const vector<U>& values) : data_(values.data()), size_(values.size()) {}
+
+	template <typename T>
+	T* Span<T>::begin() const { return data_; }
+
+	template <typename T>
+	T* Span<T>::end() const { return data_ + size_; }
+
+	template <typename T>
+	T* Span<T>::data() const { return data_; }
+
+	template <typename T>
+	size_t Span<T>::size() const { return size_; }
+
+	template <typename T>
+	bool Span<T>::empty() const { return size_ == 0; }
+
+	template <typename T>
+	T& Span<T>::operator[](size_t index) const { return data_[index]; }
+
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	//--------------INPUT STATE CLASS-----------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	const Uint8 InputState::kDown;
+	const Uint8 InputState::kPressed;
+	const Uint8 InputState::kReleased;
+
+	InputState::InputState() : keys_(), buttons_(), mouse_{ 0, 0 }, motion_{ 0, 0 } {}
+
+	Uint8 InputState::Press(Uint8 state) { return state | kDown | kPressed; }
+
+	Uint8 InputState::Release(Uint8 state) { return (state & ~kDown) | kReleased; }
+
+	void InputState::BeginFrame() {
+		// Only the held bit survives into the next frame
+		for (Uint8& key : keys_)
+			key &= kDown;
+		for (Uint8& button : buttons_)
+			button &= kDown;
+		motion_ = SDL_Point{ 0, 0 };
+	}
+
+	void InputState::Apply(const Event& event) {
+		switch (event.type) {
+		case SDL_KEYDOWN:
+			if (!event.key.repeat && (unsigned)event.key.keysym.scancode < SDL_NUM_SCANCODES)
+				keys_[event.key.keysym.scancode] = Press(keys_[event.key.keysym.scancode]);
+			break;
+		case SDL_KEYUP:
+			if ((unsigned)event.key.keysym.scancode < SDL_NUM_SCANCODES)
+				keys_[event.key.keysym.scancode] = Release(keys_[event.key.keysym.scancode]);
+			break;
+		case SDL_MOUSEMOTION:
+			mouse_ = SDL_Point{ event.motion.x, event.motion.y };
+			motion_.x += event.motion.xrel;
+			motion_.y += event.motion.yrel;
+			break;
+		case SDL_MOUSEBUTTONDOWN:
+		case SDL_MOUSEBUTTONUP:
+			mouse_ = SDL_Point{ event.button.x, event.button.y };
+			if (event.button.button < sizeof(buttons_))
+				buttons_[event.button.button] = event.type == SDL_MOUSEBUTTONDOWN
+					? Press(buttons_[event.button.button]) : Release(buttons_[event.button.button]);
+			break;
+		}
+	}
+
+	bool InputState::IsKeyDown(SDL_Scancode key) const {
+		return (unsigned)key < SDL_NUM_SCANCODES && (keys_[key] & kDown);
+	}
+
+	bool InputState::WasKeyPressed(SDL_Scancode key) const {
+		return (unsigned)key < SDL_NUM_SCANCODES && (keys_[key] & kPressed);
+	}
+
+	bool InputState::WasKeyReleased(SDL_Scancode key) const {
+		return (unsigned)key < SDL_NUM_SCANCODES && (keys_[key] & kReleased);
+	}
+
+	bool InputState::IsButtonDown(int button) const {
+		return (unsigned)button < sizeof(buttons_) && (buttons_[button] & kDown);
+	}
+
+	bool InputState::WasButtonPressed(int button) const {
+		return (unsigned)button < sizeof(buttons_) && (buttons_[button] & kPressed);
+	}
+
+	bool InputState::WasButtonReleased(int button) const {
+		return (unsigned)button < sizeof(buttons_) && (buttons_[button] & kReleased);
+	}
+
+	SDL_Point InputState::GetMousePosition() const { return mouse_; }
+
+	SDL_Point InputState::GetMouseMotion() const { return motion_; }
+
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	//--------------INPUT LOG CLASSES-----------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	static const char kInputLogMagic[8] = { 'S', 'G', 'L', '2', 'I', 'N', 'P', '2' };
+
+	// Seven bits a byte, low bits first, the top bit set on all but the last
+	static void PutVarint(vector<Uint8>& out, Uint32 value) {
+		for (; value >= 0x80; value >>= 7)
+			out.push_back((Uint8)(value | 0x80));
+		out.push_back((Uint8)value);
+	}
+
+	static bool GetVarint(const vector<Uint8>& data, size_t& offset, Uint32& value) {
+		value = 0;
+		for (int shift = 0; shift < 35 && offset < data.size(); shift += 7) {
+			Uint8 byte = data[offset++];
+			value |= (Uint32)(byte & 0x7F) << shift;
+			if (!(byte & 0x80))
+				return true;
+		}
+		return false;
+	}
+
+	// The bits of the double, low byte first, so replay sees exactly the recorded value
+	static void PutDouble(vector<Uint8>& out, double value) {
+		Uint64 bits;
+		memcpy(&bits, &value, sizeof(bits));
+		for (int i = 0; i < 8; i++)
+			out.push_back((Uint8)(bits >> (8 * i)));
+	}
+
+	static bool GetDouble(const vector<Uint8>& data, size_t& offset, double& value) {
+		if (data.size() - offset < 8)
+			return false;
+		Uint64 bits = 0;
+		for (int i = 0; i < 8; i++)
+			bits |= (Uint64)data[offset++] << (8 * i);
+		memcpy(&value, &bits, sizeof(value));
+		return true;
+	}
+
+	// Interleaves signs so small negative numbers stay short
+	static Uint32 ZigZag(Sint32 value) { return ((Uint32)value << 1) ^ (Uint32)(value >> 31); }
+
+	static Sint32 UnZigZag(Uint32 value) { return (Sint32)(value >> 1) ^ -(Sint32)(value & 1); }
+
+	InputRecorder::InputRecorder() : file_(nullptr, fclose) {}
+
+	bool InputRecorder::Open(const string& path, Uint32 seed) {
+		file_.reset(fopen(path.c_str(), "wb"));
+		if (!file_)
+			return false;
+		Uint8 seed_bytes[4] = { (Uint8)seed, (Uint8)(seed >> 8), (Uint8)(seed >> 16), (Uint8)(seed >> 24) };
+		fwrite(kInputLogMagic, 1, sizeof(kInputLogMagic), file_.get());
+		fwrite(seed_bytes, 1, sizeof(seed_bytes), file_.get());
+		return true;
+	}
+
+	void InputRecorder::Close() { file_.reset(); }
+
+	bool InputRecorder::IsOpen() const { return file_ != nullptr; }
+
+	void InputRecorder::WriteFrame(double elapsed, const vector<Event>& events) {
+		if (!file_)
+			return;
+		frame_.clear();
+		PutDouble(frame_, elapsed);
+		size_t count_offset = frame_.size();
+		Uint32 count = 0;
+		frame_.push_back(0);
+		for (const Event& event : events) {
+			switch (event.type) {
+			case SDL_KEYDOWN:
+			case SDL_KEYUP:
+				PutVarint(frame_, event.type);
+				PutVarint(frame_, event.key.keysym.scancode);
+				PutVarint(frame_, (Uint32)event.key.keysym.sym);
+				PutVarint(frame_, event.key.keysym.mod);
+				PutVarint(frame_, event.key.repeat);
+				break;
+			case SDL_MOUSEMOTION:
+				PutVarint(frame_, event.type);
+				PutVarint(frame_, event.motion.which);
+				PutVarint(frame_, event.motion.state);
+				PutVarint(frame_, ZigZag(event.motion.x));
+				PutVarint(frame_, ZigZag(event.motion.y));
+				PutVarint(frame_, ZigZag(event.motion.xrel));
+				PutVarint(frame_, ZigZag(event.motion.yrel));
+				break;
+			case SDL_MOUSEBUTTONDOWN:
+			case SDL_MOUSEBUTTONUP:
+				PutVarint(frame_, event.type);
+				PutVarint(frame_, event.button.which);
+				PutVarint(frame_, event.button.button);
+				PutVarint(frame_, event.button.clicks);
+				PutVarint(frame_, ZigZag(event.button.x));
+				PutVarint(frame_, ZigZag(event.button.y));
+				break;
+			case SDL_WINDOWEVENT:
+				if (event.window.event != SDL_WINDOWEVENT_ENTER && event.window.event != SDL_WINDOWEVENT_LEAVE)
+					continue;
+				PutVarint(frame_, event.type);
+				PutVarint(frame_, event.window.event);
+				break;
+			case SDL_QUIT:
+				PutVarint(frame_, event.type);
+				break;
+			default:
+				continue;
+			}
+			count++;
+		}
+		// The count goes before the events, and is rarely over a byte long
+		if (count >= 0x80) {
+			vector<Uint8> prefix;
+			PutVarint(prefix, count);
+			frame_.erase(frame_.begin() + count_offset);
+			frame_.insert(frame_.begin() + count_offset, prefix.begin(), prefix.end());
+		}
+		else
+			frame_[count_offset] = (Uint8)count;
+		fwrite(frame_.data(), 1, frame_.size(), file_.get());
+	}
+
+	InputPlayer::InputPlayer() : offset_(0), seed_(0), clock_(0.0) {}
+
+	bool InputPlayer::Open(const string& path) {
+		std::unique_ptr<FILE, int(*)(FILE*)> file(fopen(path.c_str(), "rb"), fclose);
+		if (!file)
+			return false;
+		data_.clear();
+		Uint8 buffer[4096];
+		for (size_t read; (read = fread(buffer, 1, sizeof(buffer), file.get())) > 0;)
+			data_.insert(data_.end(), buffer, buffer + read);
+		const size_t header = sizeof(kInputLogMagic) + 4;
+		if (data_.size() < header || !std::equal(kInputLogMagic, kInputLogMagic + sizeof(kInputLogMagic),
+			data_.begin()))
+			return false;
+		const Uint8* seed = &data_[sizeof(kInputLogMagic)];
+		seed_ = seed[0] | ((Uint32)seed[1] << 8) | ((Uint32)seed[2] << 16) | ((Uint32)seed[3] << 24);
+		offset_ = header;
+		clock_ = 0.0;
+		return true;
+	}
+
+	Uint32 InputPlayer::GetSeed() const { return seed_; }
+
+	bool InputPlayer::ReadFrame(double& elapsed, vector<Event>& events) {
+		events.clear();
+		Uint32 count;
+		if (!GetDouble(data_, offset_, elapsed) || !GetVarint(data_, offset_, count))
+			return false;
+		clock_ += elapsed;
+		Uint32 timestamp = (Uint32)(clock_ * 1000.0);
+		for (Uint32 i = 0; i < count; i++) {
+			Event event = Event();
+			Uint32 type, v[6];
+			if (!GetVarint(data_, offset_, type))
+				return false;
+			int fields = type == SDL_KEYDOWN || type == SDL_KEYUP ? 4
+				: type == SDL_MOUSEMOTION ? 6
+				: type == SDL_MOUSEBUTTONDOWN || type == SDL_MOUSEBUTTONUP ? 5
+				: type == SDL_WINDOWEVENT ? 1 : 0;
+			for (int field = 0; field < fields; field++)
+				if (!GetVarint(data_, offset_, v[field]))
+					return false;
+			event.type = type;
+			event.common.timestamp = timestamp;
+			switch (type) {
+			case SDL_KEYDOWN:
+			case SDL_KEYUP:
+				event.key.state = type == SDL_KEYDOWN ? SDL_PRESSED : SDL_RELEASED;
+				event.key.keysym.scancode = (SDL_Scancode)v[0];
+				event.key.keysym.sym = (SDL_Keycode)v[1];
+				event.key.keysym.mod = (Uint16)v[2];
+				event.key.repeat = (Uint8)v[3];
+				break;
+			case SDL_MOUSEMOTION:
+				event.motion.which = v[0];
+				event.motion.state = v[1];
+				event.motion.x = UnZigZag(v[2]);
+				event.motion.y = UnZigZag(v[3]);
+				event.motion.xrel = UnZigZag(v[4]);
+				event.motion.yrel = UnZigZag(v[5]);
+				break;
+			case SDL_MOUSEBUTTONDOWN:
+			case SDL_MOUSEBUTTONUP:
+				event.button.state = type == SDL_MOUSEBUTTONDOWN ? SDL_PRESSED : SDL_RELEASED;
+				event.button.which = v[0];
+				event.button.button = (Uint8)v[1];
+				event.button.clicks = (Uint8)v[2];
+				event.button.x = UnZigZag(v[3]);
+				event.button.y = UnZigZag(v[4]);
+				break;
+			case SDL_WINDOWEVENT:
+				event.window.event = (Uint8)v[0];
+				break;
+			}
+			events.push_back(event);
+		}
+		return true;
+	}
+
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	//--------------BASE WINDOW CLASS-----------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	Window::Window(const string& title, int width, int height,
+		const Color& background)
+		: Window(title, width, height, background, WindowMode::kShown) {}
+
+	Window::Window(const string& title, int width, int height,
+		const Color& background, WindowMode mode)
+		: window_(nullptr), renderer_(nullptr), surface_(nullptr), width_(width), height_(height), background_color_(background),
+		invalid_(true), running_(false),
+		draw_color_(background), counters_(), frame_counters_(),
+		target_fps_(0), fixed_timestep_(0.0), accumulator_(0.0), idle_wait_(false),
+		timing_(), profiler_(), profiler_overlay_(false), backend_(RenderBackend::kRenderer),
+		raster_(), raster_texture_(nullptr), pipelined_(false), pipeline_(),
+		font_(&GlyphAtlas::BuiltIn()), font_texture_(nullptr) {
+		if (mode == WindowMode::kOffscreen) {
+			// Only events and timers are needed; no video driver is touched
+			if (SDL_Init(SDL_INIT_EVENTS | SDL_INIT_TIMER)) return;
+			surface_ = SDL_CreateRGBSurface(0, width, height, 32,
+				0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+			if (!surface_) return;
+			renderer_ = SDL_CreateSoftwareRenderer(surface_);
+			if (renderer_) {
+				SDL_SetRenderDrawBlendMode(renderer_, SDL_BLENDMODE_BLEND);
+				SDL_SetRenderDrawColor(renderer_, draw_color_.GetRed(), draw_color_.GetGreen(),
+					draw_color_.GetBlue(), draw_color_.GetAlpha());
+			}
+			return;
+		}
+		if (SDL_Init(SDL_INIT_EVERYTHING)) return;
+		if (SDL_CreateWindowAndRenderer(width, height, SDL_WINDOW_SHOWN, &window_,
+			&renderer_))
+			return;
+		SDL_SetRenderDrawBlendMode(renderer_, SDL_BLENDMODE_BLEND);
+		SDL_SetRenderDrawColor(renderer_, draw_color_.GetRed(), draw_color_.GetGreen(),
+			draw_color_.GetBlue(), draw_color_.GetAlpha());
+		SDL_SetWindowTitle(window_, title.c_str());
+	}
+
+	// Textures belong to the renderer, so they go first
+	Window::~Window() {
+		recorder_.reset();
+		shape_cache_.Clear();
+		sprites_.Clear();
+		if (font_texture_)
+			SDL_DestroyTexture(font_texture_);
+		if (raster_texture_)
+			SDL_DestroyTexture(raster_texture_);
+		if (renderer_)
+			SDL_DestroyRenderer(renderer_);
+		if (surface_)
+			SDL_FreeSurface(surface_);
+		if (window_)
+			SDL_DestroyWindow(window_);
+	}
+
+	void Window::SetBackgroundColor(const Color& color) { background_color_ = color; }
+
+	void Window::PrePaint() { ClearFrame(background_color_); }
+
+	void Window::ClearFrame(Color color) {
+		FlushPoints();
+		SetDrawColor(color);
+		if (backend_ == RenderBackend::kSoftware)
+			raster_.Clear(color);
+		else
+			SDL_RenderClear(renderer_);
+		counters_.draw_calls++;
+	}
+
+	void Window::PostPaint() {
+		FlushPoints();
+		if (backend_ == RenderBackend::kSoftware)
+			UploadRaster();
+		if (recorder_ && recorder_->IsRecording())
+			CaptureFrame();
+		if (profiler_overlay_)
+			DrawProfilerOverlay();
+		FlushPoints();
+		Uint64 start = SDL_GetPerformanceCounter();
+		SDL_RenderPresent(renderer_);
+		profiler_.Add(FrameMetric::kPresentSeconds, SecondsSince(start));
+		invalid_ = false;
+	}
+
+	void Window::PaintAll() {
+		counters_ = RenderCounters();
+		Uint64 start = SDL_GetPerformanceCounter();
+		PrePaint();
+		profiler_.Add(FrameMetric::kPrePaintSeconds, SecondsSince(start));
+
+		start = SDL_GetPerformanceCounter();
+		Paint();
+		profiler_.Add(FrameMetric::kPaintSeconds, SecondsSince(start));
+
+		// PostPaint presents, which is timed on its own
+		double present = profiler_.Current(FrameMetric::kPresentSeconds);
+		start = SDL_GetPerformanceCounter();
+		PostPaint();
+		present = profiler_.Current(FrameMetric::kPresentSeconds) - present;
+		profiler_.Add(FrameMetric::kPostPaintSeconds, SecondsSince(start) - present);
+
+		frame_counters_ = counters_;
+		profiler_.Add(FrameMetric::kDrawCalls, counters_.draw_calls);
+		profiler_.Add(FrameMetric::kStateChanges, counters_.state_changes);
+		profiler_.Add(FrameMetric::kObjectsPainted, counters_.objects_painted);
+	}
+
+	void Window::DrawProfilerOverlay() {
+		static const int kBarWidth = 2;
+		static const int kHeight = 100;
+		static const double kPixelsPerSecond = kHeight / (2.0 / 60.0);  // two 60 Hz frames
+		static const FrameMetric kPhases[] = {
+			FrameMetric::kEventSeconds, FrameMetric::kUpdateSeconds,
+			FrameMetric::kPrePaintSeconds, FrameMetric::kPaintSeconds,
+			FrameMetric::kPostPaintSeconds, FrameMetric::kPresentSeconds
+		};
+		static constexpr Color kPhaseColors[] = {
+			Color(230, 80, 80, 255), Color(240, 200, 60, 255), Color(120, 120, 255, 255),
+			Color(80, 220, 120, 255), Color(60, 200, 220, 255), Color(200, 100, 220, 255)
+		};
+
+		// The overlay is not part of the frame being measured, and is drawn
+		// over the uploaded frame so it never lands in the software one
+		RenderCounters saved = counters_;
+		RenderBackend backend = backend_;
+		backend_ = RenderBackend::kRenderer;
+		// The software backend changes draw_color_ without telling SDL
+		if (backend == RenderBackend::kSoftware)
+			SDL_SetRenderDrawColor(renderer_, draw_color_.GetRed(), draw_color_.GetGreen(),
+				draw_color_.GetBlue(), draw_color_.GetAlpha());
+		size_t frames = std::min(profiler_.Size(), (size_t)(width_ / kBarWidth));
+		size_t first = profiler_.Size() - frames;
+		DrawFilledRectangle(Color::kBlack, { 0, 0, (int)frames * kBarWidth, kHeight });
+		for (size_t phase = 0; phase < sizeof(kPhases) / sizeof(kPhases[0]); phase++) {
+			spans_.clear();
+			for (size_t i = 0; i < frames; i++) {
+				const FrameSample& sample = profiler_.At(first + i);
+				double below = 0.0;
+				for (size_t p = 0; p < phase; p++)
+					below += sample.values[(int)kPhases[p]];
+				int bottom = kHeight - (int)(below * kPixelsPerSecond);
+				int top = kHeight - (int)((below + sample.values[(int)kPhases[phase]]) * kPixelsPerSecond);
+				top = std::max(top, 0);
+				if (bottom > top)
+					spans_.push_back({ (int)i * kBarWidth, top, kBarWidth, bottom - top });
+			}
+			if (spans_.empty())
+				continue;
+			SetDrawColor(kPhaseColors[phase]);
+			SubmitFillRects(spans_.data(), spans_.size());
+		}
+		// Marks the budget of one 60 Hz frame
+		DrawFilledRectangle(Color::kWhite, { 0, kHeight / 2, (int)frames * kBarWidth, 1 });
+		FlushPoints();
+		backend_ = backend;
+		counters_ = saved;
+	}
+
+	void Window::Repaint() {
+		// A pipelined Run paints every snapshot, and Update is on another thread
+		if (!pipeline_)
+			invalid_ = true;
+	}
+
+	// On the renderer backend SDL always holds draw_color_, so an
+	// unchanged color costs one integer comparison
+	void Window::SetDrawColor(Color color) {
+		if (color == draw_color_)
+			return;
+		FlushPoints();
+		draw_color_ = color;
+		// The software backend reads draw_color_ as it draws
+		if (backend_ == RenderBackend::kSoftware)
+			return;
+		SDL_SetRenderDrawColor(renderer_, color.GetRed(), color.GetGreen(), color.GetBlue(),
+			color.GetAlpha());
+		counters_.state_changes++;
+	}
+
+	void Window::FlushPoints() {
+		if (points_.empty())
+			return;
+		if (backend_ == RenderBackend::kSoftware)
+			raster_.DrawPoints(points_.data(), points_.size(), draw_color_);
+		else
+			SDL_RenderDrawPoints(renderer_, points_.data(), (int)points_.size());
+		points_.clear();
+		counters_.draw_calls++;
+	}
+
+	void Window::SubmitFillRects(const SDL_Rect* rects, size_t count) {
+		if (backend_ == RenderBackend::kSoftware)
+			raster_.FillRects(rects, count, draw_color_);
+		else
+			SDL_RenderFillRects(renderer_, rects, (int)count);
+		counters_.draw_calls++;
+	}
+
+	void Window::SubmitDrawRects(const SDL_Rect* rects, size_t count) {
+		if (backend_ == RenderBackend::kSoftware)
+			raster_.DrawRects(rects, count, draw_color_);
+		else
+			SDL_RenderDrawRects(renderer_, rects, (int)count);
+		counters_.draw_calls++;
+	}
+
+	void Window::SubmitDrawLines(const SDL_Point* points, size_t count) {
+		if (backend_ == RenderBackend::kSoftware)
+			raster_.DrawLines(points, count, draw_color_);
+		else
+			SDL_RenderDrawLines(renderer_, points, (int)count);
+		counters_.draw_calls++;
+	}
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	// Appends source drawn to dest as two triangles, tinted through the
+	// vertex colors; scale maps texture pixels to texture coordinates
+	static void AppendQuad(vector<SDL_Vertex>& vertices, vector<int>& indices, const SDL_Rect& source,
+		const SDL_Rect& dest, Color tint, float scale_x, float scale_y) {
+		SDL_Color color{ tint.GetRed(), tint.GetGreen(), tint.GetBlue(), tint.GetAlpha() };
+		int first = (int)vertices.size();
+		for (int corner = 0; corner < 4; corner++) {
+			int right = corner & 1, bottom = corner >> 1;
+			vertices.push_back(SDL_Vertex{
+				SDL_FPoint{ (float)(dest.x + right * dest.w), (float)(dest.y + bottom * dest.h) }, color,
+				SDL_FPoint{ (source.x + right * source.w) * scale_x, (source.y + bottom * source.h) * scale_y } });
+		}
+		const int corners[6] = { 0, 1, 2, 1, 3, 2 };
+		for (int corner : corners)
+			indices.push_back(first + corner);
+	}
+#endif
+
+	void Window::SubmitGlyphs(const GlyphQuad* glyphs, size_t count) {
+		if (count == 0)
+			return;
+		if (backend_ == RenderBackend::kSoftware) {
+			raster_.DrawGlyphs(*font_, glyphs, count, draw_color_);
+			counters_.draw_calls++;
+			return;
+		}
+		SDL_Texture* texture = GetFontTexture();
+		if (!texture)
+			return;
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+		float scale_x = 1.0f / font_->GetWidth(), scale_y = 1.0f / font_->GetHeight();
+		quad_vertices_.clear();
+		quad_indices_.clear();
+		for (size_t i = 0; i < count; i++)
+			AppendQuad(quad_vertices_, quad_indices_, glyphs[i].source, glyphs[i].dest, draw_color_,
+				scale_x, scale_y);
+		SDL_RenderGeometry(renderer_, texture, quad_vertices_.data(), (int)quad_vertices_.size(),
+			quad_indices_.data(), (int)quad_indices_.size());
+		counters_.draw_calls++;
+#else
+		SDL_SetTextureColorMod(texture, draw_color_.GetRed(), draw_color_.GetGreen(), draw_color_.GetBlue());
+		SDL_SetTextureAlphaMod(texture, draw_color_.GetAlpha());
+		for (size_t i = 0; i < count; i++)
+			SDL_RenderCopy(renderer_, texture, &glyphs[i].source, &glyphs[i].dest);
+		counters_.draw_calls += (unsigned)count;
+#endif
+	}
+
+	void Window::SubmitSprites(const SpriteQuad* sprites, size_t count) {
+		if (count == 0)
+			return;
+		if (backend_ == RenderBackend::kSoftware) {
+			raster_.DrawSprites(sprites_, sprites, count);
+			counters_.draw_calls++;
+			return;
+		}
+		for (size_t first = 0, last; first < count; first = last) {
+			int page = sprites[first].page;
+			for (last = first + 1; last < count && sprites[last].page == page; last++) {}
+			SDL_Texture* texture = sprites_.GetTexture(renderer_, page);
+			if (!texture)
+				continue;
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+			float scale_x = 1.0f / sprites_.GetPageWidth(page);
+			float scale_y = 1.0f / sprites_.GetPageHeight(page);
+			quad_vertices_.clear();
+			quad_indices_.clear();
+			for (size_t i = first; i < last; i++)
+				AppendQuad(quad_vertices_, quad_indices_, sprites[i].source, sprites[i].dest,
+					sprites[i].tint, scale_x, scale_y);
+			SDL_RenderGeometry(renderer_, texture, quad_vertices_.data(), (int)quad_vertices_.size(),
+				quad_indices_.data(), (int)quad_indices_.size());
+			counters_.draw_calls++;
+#else
+			// The texture keeps its modulation, so it only changes with the tint
+			for (size_t i = first; i < last; i++) {
+				const Color& tint = sprites[i].tint;
+				if (i == first || tint != sprites[i - 1].tint) {
+					SDL_SetTextureColorMod(texture, tint.GetRed(), tint.GetGreen(), tint.GetBlue());
+					SDL_SetTextureAlphaMod(texture, tint.GetAlpha());
+				}
+				SDL_RenderCopy(renderer_, texture, &sprites[i].source, &sprites[i].dest);
+			}
+			counters_.draw_calls += (unsigned)(last - first);
+#endif
+		}
+	}
+
+	SDL_Texture* Window::GetFontTexture() {
+		if (font_texture_)
+			return font_texture_;
+		int width = font_->GetWidth(), height = font_->GetHeight();
+		font_texture_ = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_ARGB8888,
+			SDL_TEXTUREACCESS_STATIC, width, height);
+		if (!font_texture_)
+			return nullptr;
+		vector<Uint32> pixels((size_t)width * height);
+		const Uint8* coverage = font_->GetCoverage();
+		for (size_t i = 0; i < pixels.size(); i++)
+			pixels[i] = coverage[i] ? 0xFFFFFFFF : 0x00FFFFFF;
+		SDL_UpdateTexture(font_texture_, nullptr, pixels.data(), width * 4);
+		SDL_SetTextureBlendMode(font_texture_, SDL_BLENDMODE_BLEND);
+		return font_texture_;
+	}
+
+	void Window::SetClipRect(const SDL_Rect* rect) {
+		if (backend_ == RenderBackend::kSoftware)
+			raster_.SetClipRect(rect);
+		else
+			SDL_RenderSetClipRect(renderer_, rect);
+	}
+
+	void Window::UploadRaster() {
+		if (!raster_texture_) {
+			raster_texture_ = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_ARGB8888,
+				SDL_TEXTUREACCESS_STREAMING, raster_.GetWidth(), raster_.GetHeight());
+			if (!raster_texture_)
+				return;
+			// The frame replaces what is on screen rather than blending onto it
+			SDL_SetTextureBlendMode(raster_texture_, SDL_BLENDMODE_NONE);
+		}
+		SDL_UpdateTexture(raster_texture_, nullptr, raster_.GetPixels(), raster_.GetPitch());
+		SDL_RenderCopy(renderer_, raster_texture_, nullptr, nullptr);
+		counters_.draw_calls++;
+	}
+
+	void Window::DrawPoint(Color color, int x, int y) {
+		SetDrawColor(color);
+		points_.push_back(SDL_Point{ x, y });
+	}
+
+	void Window::DrawPoint(int x, int y) {
+		points_.push_back(SDL_Point{ x, y });
+	}
+
+	void Window::DrawPoints(Color color, const SDL_Point* points, size_t count) {
+		SetDrawColor(color);
+		points_.insert(points_.end(), points, points + count);
+	}
+
+	void Window::DrawRectangle(Color color, const SDL_Rect& rect) {
+		FlushPoints();
+		SetDrawColor(color);
+		SubmitDrawRects(&rect, 1);
+	}
+
+	void Window::DrawFilledRectangle(Color color, const SDL_Rect & rect) {
+		FlushPoints();
+		SetDrawColor(color);
+		SubmitFillRects(&rect, 1);
+	}
+
+	// Queues eight points on the rim of a circle reflected from
+	// one point across eight octants.
+	// (edge_x, edge_y) is a point on the rim.
+	// (center_x, center_y) is the circle's center.
+	// Adapted from 
+	// Computer Graphics: The Principles behind the Art and Science
+	// Cornel Pokorny and Curtis Gerald (c) 1989
+	inline void Window::EightOcts(int edge_x, int edge_y,
+		int center_x, int center_y) {
+		points_.push_back(SDL_Point{ edge_x + center_x, edge_y + center_y });
+		points_.push_back(SDL_Point{ -edge_x + center_x, edge_y + center_y });
+		points_.push_back(SDL_Point{ edge_x + center_x, -edge_y + center_y });
+		points_.push_back(SDL_Point{ -edge_x + center_x, -edge_y + center_y });
+		points_.push_back(SDL_Point{ edge_y + center_x, edge_x + center_y });
+		points_.push_back(SDL_Point{ -edge_y + center_x, edge_x + center_y });
+		points_.push_back(SDL_Point{ edge_y + center_x, -edge_x + center_y });
+		points_.push_back(SDL_Point{ -edge_y + center_x, -edge_x + center_y });
+	}
+
+	void Window::DrawCircle(Color color, int x, int y, int radius) {
+		SetDrawColor(color);
+		AppendCirclePoints(x, y, radius);
+	}
+
+	void Window::AppendCirclePoints(int x, int y, int radius) {
+		AppendCircleRim(points_, x, y, radius);
+	}
+
+	void Window::AppendEllipseSpans(int x, int y, int radius_x, int radius_y) {
+		AppendEllipseRows(spans_, x, y, radius_x, radius_y);
+	}
+
+	void Window::DrawFilledCircle(Color color, int x, int y, int radius) {
+		DrawFilledEllipse(color, x, y, radius, radius);
+	}
+
+	void Window::DrawFilledEllipse(Color color, int x, int y, int radius_x, int radius_y) {
+		FlushPoints();
+		SetDrawColor(color);
+		spans_.clear();
+		AppendEllipseSpans(x, y, radius_x, radius_y);
+		if (!spans_.empty())
+			SubmitFillRects(spans_.data(), spans_.size());
+	}
+
+	void Window::DrawLine(Color color, int x1, int y1, int x2, int y2) {
+		SDL_Point points[2] = { { x1, y1 }, { x2, y2 } };
+		DrawPolyline(color, points, 2);
+	}
+
+	void Window::DrawPolyline(Color color, const SDL_Point* points, size_t count) {
+		if (count < 2)
+			return;
+		FlushPoints();
+		SetDrawColor(color);
+		SubmitDrawLines(points, count);
+	}
+
+	void Window::DrawString(Color color, int x, int y, const string& text, int scale) {
+		auto found = layouts_.find(text);
+		if (found == layouts_.end()) {
+			if (layouts_.size() >= kMaxCachedLayouts)
+				layouts_.clear();
+			found = layouts_.emplace(text, vector<GlyphQuad>()).first;
+			font_->Layout(text, 1, found->second);
+		}
+		glyphs_.clear();
+		for (GlyphQuad glyph : found->second) {
+			glyph.dest = SDL_Rect{ x + glyph.dest.x * scale, y + glyph.dest.y * scale,
+				glyph.dest.w * scale, glyph.dest.h * scale };
+			glyphs_.push_back(glyph);
+		}
+		FlushPoints();
+		SetDrawColor(color);
+		SubmitGlyphs(glyphs_.data(), glyphs_.size());
+	}
+
+	void Window::SetFont(const GlyphAtlas& font) {
+		if (&font == font_)
+			return;
+		font_ = &font;
+		if (font_texture_)
+			SDL_DestroyTexture(font_texture_);
+		font_texture_ = nullptr;
+		layouts_.clear();
+		invalid_ = true;
+	}
+
+	const GlyphAtlas& Window::GetFont() const { return *font_; }
+
+	SpriteImage Window::LoadSprite(const string& path) { return sprites_.LoadBmp(path); }
+
+	SpriteImage Window::AddSprite(const Uint32* pixels, int width, int height) {
+		return sprites_.Add(pixels, width, height, width * 4);
+	}
+
+	const SpriteAtlas& Window::GetSpriteAtlas() const { return sprites_; }
+
+	void Window::DrawSprite(const SpriteImage& image, const SDL_Rect& dest, Color tint) {
+		if (image.page < 0)
+			return;
+		FlushPoints();
+		SpriteQuad sprite{ image.source, dest, tint, image.page };
+		SubmitSprites(&sprite, 1);
+	}
+
+	void Window::DrawCommands(const DrawList& list) {
+		const vector<DrawCommand>& commands = list.Commands();
+		for (const DrawBatch& batch : list.Batches()) {
+			const DrawCommand* first = commands.data() + batch.first;
+			const DrawCommand* last = first + batch.count;
+			if (batch.kind != DrawKind::kPoint && batch.kind != DrawKind::kCircle)
+				FlushPoints();
+			// Sprites carry their tints with them and need no draw color
+			if (batch.kind != DrawKind::kSprite)
+				SetDrawColor(batch.color);
+			spans_.clear();
+			switch (batch.kind) {
+			case DrawKind::kPoint:
+				for (const DrawCommand* c = first; c != last; c++)
+					points_.push_back(SDL_Point{ c->rect.x, c->rect.y });
+				break;
+			case DrawKind::kCircle:
+				for (const DrawCommand* c = first; c != last; c++) {
+					SDL_Texture* texture = GetCircleTexture(c->color, c->rect.w / 2, false);
+					if (texture) {
+						FlushPoints();
+						SDL_RenderCopy(renderer_, texture, nullptr, &c->rect);
+						counters_.draw_calls++;
+					}
+					else
+						AppendCirclePoints(c->rect.x + c->rect.w / 2, c->rect.y + c->rect.h / 2, c->rect.w / 2);
+				}
+				break;
+			case DrawKind::kRectangle:
+				for (const DrawCommand* c = first; c != last; c++)
+					spans_.push_back(c->rect);
+				SubmitDrawRects(spans_.data(), spans_.size());
+				break;
+			case DrawKind::kFilledRectangle:
+				for (const DrawCommand* c = first; c != last; c++)
+					spans_.push_back(c->rect);
+				SubmitFillRects(spans_.data(), spans_.size());
+				break;
+			case DrawKind::kFilledCircle:
+				for (const DrawCommand* c = first; c != last; c++) {
+					SDL_Texture* texture = GetCircleTexture(c->color, c->rect.w / 2, true);
+					if (texture) {
+						SDL_RenderCopy(renderer_, texture, nullptr, &c->rect);
+						counters_.draw_calls++;
+					}
+					else
+						AppendEllipseSpans(c->rect.x + c->rect.w / 2, c->rect.y + c->rect.h / 2, c->rect.w / 2, c->rect.h / 2);
+				}
+				if (!spans_.empty())
+					SubmitFillRects(spans_.data(), spans_.size());
+				break;
+			case DrawKind::kPolyline:
+				for (const DrawCommand* c = first; c != last; c++)
+					SubmitDrawLines(list.Vertices().data() + c->first_item, c->item_count);
+				break;
+			case DrawKind::kText:
+				for (const DrawCommand* c = first; c != last; c++)
+					SubmitGlyphs(list.Glyphs().data() + c->first_item, c->item_count);
+				break;
+			case DrawKind::kSprite:
+				sprite_batch_.clear();
+				for (const DrawCommand* c = first; c != last; c++)
+					sprite_batch_.push_back(list.Sprites()[c->first_item]);
+				SubmitSprites(sprite_batch_.data(), sprite_batch_.size());
+				break;
+			}
+		}
+	}
+
+	const RenderCounters& Window::GetFrameCounters() const { return frame_counters_; }
+
+	// Rasterizes on the CPU with the same span and Bresenham code the
+	// renderer path uses, so a cached circle matches a directly drawn one
+	// pixel for pixel, then uploads it as a static blended texture.
+	SDL_Texture* Window::GetCircleTexture(Color color, int radius, bool filled) {
+		// Spans are as cheap as a copy when drawing on the CPU
+		if (backend_ == RenderBackend::kSoftware)
+			return nullptr;
+		int size = 2 * radius + 1;
+		size_t bytes = (size_t)size * size * 4;
+		if (radius < 0 || bytes > shape_cache_.GetBudget())
+			return nullptr;
+		Uint64 key = ShapeCache::CircleKey(radius, color, filled);
+		SDL_Texture* texture = shape_cache_.Find(key);
+		if (texture)
+			return texture;
+
+		texture = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_ARGB8888,
+			SDL_TEXTUREACCESS_STATIC, size, size);
+		if (!texture)
+			return nullptr;
+		vector<Uint32> pixels((size_t)size * size, 0);
+		Uint32 value = color.GetArgb();
+		// spans_ and points_ may hold queued work; rasterize after it
+		if (filled) {
+			size_t queued = spans_.size();
+			AppendEllipseSpans(radius, radius, radius, radius);
+			for (size_t i = queued; i < spans_.size(); i++)
+				for (int y = spans_[i].y; y < spans_[i].y + spans_[i].h; y++)
+					std::fill_n(&pixels[(size_t)y * size + spans_[i].x], spans_[i].w, value);
+			spans_.resize(queued);
+		}
+		else {
+			size_t queued = points_.size();
+			AppendCirclePoints(radius, radius, radius);
+			for (size_t i = queued; i < points_.size(); i++)
+				pixels[(size_t)points_[i].y * size + points_[i].x] = value;
+			points_.resize(queued);
+		}
+		SDL_UpdateTexture(texture, nullptr, pixels.data(), size * 4);
+		SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+		if (!shape_cache_.Insert(key, texture, bytes)) {
+			SDL_DestroyTexture(texture);
+			return nullptr;
+		}
+		return texture;
+	}
+
+	ShapeCache& Window::GetShapeCache() { return shape_cache_; }
+
+	const int Window::kIdleTimeoutMs;
+	const size_t Window::kMaxCachedLayouts;
+	constexpr double Window::kMaxFrameSeconds;
+
+	void Window::Update() {}
+
+	void Window::Update(double dt) { Update(); }
+
+	void Window::DispatchEvent(const SDL_Event& event) {
+		switch (event.type) {
+		case SDL_KEYDOWN:
+			KeyPressed(event.key);
+			break;
+		case SDL_MOUSEMOTION:
+			MouseMoved(event.motion);
+			break;
+		case SDL_MOUSEBUTTONDOWN:
+			MousePressed(event.button);
+			break;
+		case SDL_MOUSEBUTTONUP:
+			MouseReleased(event.button);
+			break;
+		case SDL_WINDOWEVENT:
+			switch (event.window.event) {
+			case SDL_WINDOWEVENT_ENTER:
+				MouseEntered();
+				break;
+			case SDL_WINDOWEVENT_LEAVE:
+				MouseExited();
+				break;
+			}
+			break;
+		}
+	}
+
+	void Window::PollEvents() {
+		Event event;
+		while (SDL_PollEvent(&event)) {
+			profiler_.Add(FrameMetric::kEventsHandled, 1);
+			events_.push_back(event);
+		}
+	}
+
+	void Window::CoalesceMotion(vector<Event>& events) {
+		size_t kept = 0;
+		for (size_t i = 0; i < events.size(); i++) {
+			const Event& event = events[i];
+			if (kept > 0 && event.type == SDL_MOUSEMOTION) {
+				MouseMotionEvent& last = events[kept - 1].motion;
+				if (last.type == SDL_MOUSEMOTION && last.windowID == event.motion.windowID &&
+					last.which == event.motion.which) {
+					int xrel = last.xrel + event.motion.xrel, yrel = last.yrel + event.motion.yrel;
+					last = event.motion;
+					last.xrel = xrel;
+					last.yrel = yrel;
+					continue;
+				}
+			}
+			events[kept++] = event;
+		}
+		events.resize(kept);
+	}
+
+	void Window::DeliverEvents(vector<Event>& events) {
+		CoalesceMotion(events);
+		input_.BeginFrame();
+		for (const Event& event : events) {
+			input_.Apply(event);
+			if (event.type == SDL_QUIT)
+				running_ = false;
+		}
+		if (!events.empty())
+			HandleEvents(events);
+	}
+
+	void Window::HandleEvents(Span<const Event> events) {
+		for (const Event& event : events)
+			DispatchEvent(event);
+	}
+
+	const InputState& Window::GetInput() const { return input_; }
+
+	unsigned Window::AdvanceTime(double elapsed) {
+		if (fixed_timestep_ <= 0.0) {
+			Advance(elapsed);
+			return 1;
+		}
+		unsigned updates = 0;
+		accumulator_ += std::min(elapsed, kMaxFrameSeconds);
+		for (; accumulator_ >= fixed_timestep_; updates++) {
+			Advance(fixed_timestep_);
+			accumulator_ -= fixed_timestep_;
+		}
+		return updates;
+	}
+
+	void Window::Advance(double dt) { Update(dt); }
+
+	void Window::Run() {
+		if (pipelined_) {
+			RunPipelined();
+			return;
+		}
+		running_ = true;
+		timing_ = FrameTiming();
+		Uint64 frequency = SDL_GetPerformanceFrequency();
+		Uint64 last_frame = SDL_GetPerformanceCounter();
+		Uint64 next_frame = last_frame;
+		while (running_) {
+			Uint64 frame_start = SDL_GetPerformanceCounter();
+			double elapsed = (double)(frame_start - last_frame) / frequency;
+			last_frame = frame_start;
+
+			PollEvents();
+			input_log_.WriteFrame(elapsed, events_);
+			DeliverEvents(events_);
+			events_.clear();
+			profiler_.Add(FrameMetric::kEventSeconds, SecondsSince(frame_start));
+
+			Uint64 update_start = SDL_GetPerformanceCounter();
+			unsigned updates = AdvanceTime(elapsed);
+			profiler_.Add(FrameMetric::kUpdateSeconds, SecondsSince(update_start));
+
+			bool painted = invalid_;
+			if (invalid_) {
+				PaintAll();
+			}
+
+			EndRunFrame(frame_start, elapsed, updates, painted);
+			if (running_)
+				WaitForNextFrame(next_frame);
+		}
+	}
+
+	void Window::EndRunFrame(Uint64 frame_start, double elapsed, unsigned updates, bool painted) {
+		timing_.frame_seconds = elapsed;
+		timing_.work_seconds = SecondsSince(frame_start);
+		profiler_.Add(FrameMetric::kWorkSeconds, timing_.work_seconds);
+		profiler_.EndFrame();
+		// The first frame's time is only the gap since Run was entered
+		if (timing_.frames > 0) {
+			timing_.average_frame_seconds = timing_.frames == 1 ? elapsed
+				: 0.9 * timing_.average_frame_seconds + 0.1 * elapsed;
+			if (timing_.average_frame_seconds > 0.0)
+				timing_.average_fps = 1.0 / timing_.average_frame_seconds;
+		}
+		timing_.updates = updates;
+		timing_.painted = painted;
+		timing_.frames++;
+	}
+
+	void Window::RunPipelined() {
+		running_ = true;
+		timing_ = FrameTiming();
+		pipeline_.reset(new Pipeline());
+		pipeline_->running = true;
+		pipeline_->updates = 0;
+		pipeline_->update_ticks = 0;
+
+		// The first frame shows the scene as it is before any update
+		PublishSnapshot();
+		std::thread simulation(&Window::Simulate, this);
+
+		Uint64 frequency = SDL_GetPerformanceFrequency();
+		Uint64 last_frame = SDL_GetPerformanceCounter();
+		Uint64 next_frame = last_frame;
+		vector<SDL_Event> events;
+		while (pipeline_->running) {
+			Uint64 frame_start = SDL_GetPerformanceCounter();
+			double elapsed = (double)(frame_start - last_frame) / frequency;
+			last_frame = frame_start;
+
+			SDL_Event event;
+			while (SDL_PollEvent(&event)) {
+				profiler_.Add(FrameMetric::kEventsHandled, 1);
+				if (event.type == SDL_QUIT)
+					pipeline_->running = false;
+				else
+					events.push_back(event);
+			}
+			// Replayed, the updates follow the main thread's frames instead
+			input_log_.WriteFrame(elapsed, events);
+			if (!events.empty()) {
+				std::lock_guard<std::mutex> lock(pipeline_->mutex);
+				pipeline_->events.insert(pipeline_->events.end(), events.begin(), events.end());
+				events.clear();
+			}
+			profiler_.Add(FrameMetric::kEventSeconds, SecondsSince(frame_start));
+
+			// Updates ran alongside the last frame rather than as part of it
+			unsigned updates = pipeline_->updates.exchange(0);
+			profiler_.Add(FrameMetric::kUpdateSeconds,
+				(double)pipeline_->update_ticks.exchange(0) / frequency);
+
+			bool painted = AcquireSnapshot() || invalid_;
+			if (painted)
+				PaintAll();
+
+			EndRunFrame(frame_start, elapsed, updates, painted);
+			if (!pipeline_->running)
+				break;
+			// A new snapshot does not wake an event wait, so poll for one
+			if (target_fps_ > 0)
+				WaitForNextFrame(next_frame);
+			else if (!painted)
+				SDL_Delay(1);
+		}
+
+		simulation.join();
+		pipeline_.reset();
+		running_ = false;
+	}
+
+	void Window::Simulate() {
+		Uint64 frequency = SDL_GetPerformanceFrequency();
+		Uint64 last_update = SDL_GetPerformanceCounter();
+		vector<SDL_Event> events;
+		while (pipeline_->running) {
+			Uint64 start = SDL_GetPerformanceCounter();
+			double elapsed = (double)(start - last_update) / frequency;
+			last_update = start;
+
+			{
+				std::lock_guard<std::mutex> lock(pipeline_->mutex);
+				events.swap(pipeline_->events);
+			}
+			DeliverEvents(events);
+			unsigned updates = AdvanceTime(elapsed);
+			if (updates > 0 || !events.empty())
+				PublishSnapshot();
+			events.clear();
+			pipeline_->updates += updates;
+			pipeline_->update_ticks += SDL_GetPerformanceCounter() - start;
+
+			// Sleeps until the next fixed update or frame is due, and at
+			// least a millisecond so a variable timestep does not spin
+			double wait = 0.0;
+			if (fixed_timestep_ > 0.0)
+				wait = fixed_timestep_ - accumulator_;
+			else if (target_fps_ > 0)
+				wait = 1.0 / target_fps_ - SecondsSince(start);
+			SDL_Delay((Uint32)(std::max(wait, 0.001) * 1000.0));
+		}
+	}
+
+	void Window::PublishSnapshot() {}
+
+	bool Window::AcquireSnapshot() { return false; }
+
+	void Window::WaitForNextFrame(Uint64& next_frame) {
+		Uint64 frequency = SDL_GetPerformanceFrequency();
+		Uint64 now = SDL_GetPerformanceCounter();
+		double wait = 0.0;
+		if (target_fps_ > 0) {
+			// Deadlines advance by whole periods so the rate does not drift,
+			// but a late frame does not earn a burst of early ones.
+			next_frame += frequency / target_fps_;
+			if (next_frame < now)
+				next_frame = now;
+			wait = (double)(next_frame - now) / frequency;
+		}
+
+		// A pipelined Run's accumulator belongs to the simulation thread
+		if (idle_wait_ && !invalid_ && !pipeline_) {
+			double idle = fixed_timestep_ > 0.0 ? fixed_timestep_ - accumulator_
+				: kIdleTimeoutMs / 1000.0;
+			wait = std::max(wait, idle);
+			// Leaves the event queued for the next frame to dispatch
+			SDL_WaitEventTimeout(nullptr, (int)(wait * 1000.0));
+		}
+		else if (wait > 0.0) {
+			SDL_Delay((Uint32)(wait * 1000.0));
+		}
+	}
+
+	bool Window::Step(double dt) {
+		Uint64 frame_start = SDL_GetPerformanceCounter();
+		PollEvents();
+		input_log_.WriteFrame(dt, events_);
+		DeliverEvents(events_);
+		events_.clear();
+		profiler_.Add(FrameMetric::kEventSeconds, SecondsSince(frame_start));
+
+		Uint64 update_start = SDL_GetPerformanceCounter();
+		AdvanceTime(dt);
+		profiler_.Add(FrameMetric::kUpdateSeconds, SecondsSince(update_start));
+
+		bool painted = invalid_;
+		if (painted)
+			PaintAll();
+		profiler_.Add(FrameMetric::kWorkSeconds, SecondsSince(frame_start));
+		profiler_.EndFrame();
+		return painted;
+	}
+
+	void Window::RenderFrame() {
+		Uint64 frame_start = SDL_GetPerformanceCounter();
+		PaintAll();
+		profiler_.Add(FrameMetric::kWorkSeconds, SecondsSince(frame_start));
+		profiler_.EndFrame();
+	}
+
+	const Uint32* Window::GetPixels() const {
+		return surface_ ? (const Uint32*)surface_->pixels : nullptr;
+	}
+
+	int Window::GetPitch() const { return surface_ ? surface_->pitch : width_ * 4; }
+
+	bool Window::ReadPixels(vector<Uint32>& pixels) {
+		FlushPoints();
+		if (backend_ == RenderBackend::kSoftware) {
+			pixels.assign(raster_.GetPixels(), raster_.GetPixels() + raster_.GetWidth() * raster_.GetHeight());
+			return true;
+		}
+		pixels.resize((size_t)width_ * height_);
+		return SDL_RenderReadPixels(renderer_, nullptr, SDL_PIXELFORMAT_ARGB8888,
+			pixels.data(), width_ * 4) == 0;
+	}
+
+	void Window::CaptureFrame() {
+		Uint32* pixels = recorder_->AcquireFrame();
+		if (!pixels)
+			return;
+		bool filled;
+		if (backend_ == RenderBackend::kSoftware) {
+			std::copy_n(raster_.GetPixels(), (size_t)width_ * height_, pixels);
+			filled = true;
+		}
+		else
+			filled = SDL_RenderReadPixels(renderer_, nullptr, SDL_PIXELFORMAT_ARGB8888,
+				pixels, width_ * 4) == 0;
+		recorder_->SubmitFrame(filled);
+	}
+
+	bool Window::StartRecording(const string& path, CaptureFormat format, size_t buffers,
+		CaptureDropPolicy policy) {
+		if (!recorder_)
+			recorder_.reset(new FrameRecorder());
+		return recorder_->Start(path, format, width_, height_, target_fps_ > 0 ? target_fps_ : 60,
+			buffers, policy);
+	}
+
+	void Window::StopRecording() {
+		if (recorder_)
+			recorder_->Stop();
+	}
+
+	bool Window::StartInputRecording(const string& path) {
+		Uint32 seed = (Uint32)SDL_GetPerformanceCounter();
+		if (!input_log_.Open(path, seed))
+			return false;
+		srand(seed);
+		return true;
+	}
+
+	void Window::StopInputRecording() { input_log_.Close(); }
+
+	bool Window::ReplayInput(const string& path, double dt) {
+		InputPlayer player;
+		if (!player.Open(path))
+			return false;
+		srand(player.GetSeed());
+		running_ = true;
+		timing_ = FrameTiming();
+		double elapsed;
+		while (running_ && player.ReadFrame(elapsed, events_)) {
+			Uint64 frame_start = SDL_GetPerformanceCounter();
+			if (dt > 0.0)
+				elapsed = dt;
+			profiler_.Add(FrameMetric::kEventsHandled, (double)events_.size());
+			DeliverEvents(events_);
+			events_.clear();
+			profiler_.Add(FrameMetric::kEventSeconds, SecondsSince(frame_start));
+
+			Uint64 update_start = SDL_GetPerformanceCounter();
+			unsigned updates = AdvanceTime(elapsed);
+			profiler_.Add(FrameMetric::kUpdateSeconds, SecondsSince(update_start));
+
+			bool painted = invalid_;
+			if (painted)
+				PaintAll();
+			EndRunFrame(frame_start, elapsed, updates, painted);
+		}
+		events_.clear();
+		running_ = false;
+		return true;
+	}
+
+	CaptureStats Window::GetRecordingStats() const {
+		return recorder_ ? recorder_->GetStats() : CaptureStats();
+	}
+
+	int Window::GetWidth() const { return width_; }
+
+	int Window::GetHeight() const { return height_; }
+
+	void Window::SetRenderBackend(RenderBackend backend) {
+		if (backend == backend_)
+			return;
+		FlushPoints();
+		backend_ = backend;
+		if (backend_ == RenderBackend::kSoftware &&
+			(raster_.GetWidth() != width_ || raster_.GetHeight() != height_))
+			raster_.Resize(width_, height_);
+		// Whatever color the renderer holds no longer matches draw_color_
+		if (backend_ == RenderBackend::kRenderer)
+			SDL_SetRenderDrawColor(renderer_, draw_color_.GetRed(), draw_color_.GetGreen(),
+				draw_color_.GetBlue(), draw_color_.GetAlpha());
+		invalid_ = true;
+	}
+
+	RenderBackend Window::GetRenderBackend() const { return backend_; }
+
+	const SoftwareRasterizer& Window::GetRasterizer() const { return raster_; }
+
+	void Window::SetFrameRate(int fps) { target_fps_ = std::max(fps, 0); }
+
+	bool Window::SetVSync(bool enabled) {
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+		return SDL_RenderSetVSync(renderer_, enabled ? 1 : 0) == 0;
+#else
+		// Older renderers fix vsync when they are created
+		return false;
+#endif
+	}
+
+	void Window::SetFixedTimestep(double seconds) { fixed_timestep_ = std::max(seconds, 0.0); }
+
+	void Window::SetIdleWait(bool enabled) { idle_wait_ = enabled; }
+
+	FrameProfiler& Window::GetProfiler() { return profiler_; }
+
+	void Window::SetProfilerOverlay(bool enabled) {
+		profiler_overlay_ = enabled;
+		invalid_ = true;
+	}
+
+	const FrameTiming& Window::GetFrameTiming() const { return timing_; }
+
+	void Window::Quit()
+	{
+		if (pipeline_)
+			pipeline_->running = false;
+		else
+			running_ = false;
+	}
+
+	void Window::KeyPressed(const KeyboardEvent & event) {}
+
+	inline void Window::MouseMoved(const MouseMotionEvent & event) {}
+
+	inline void Window::MousePressed(const MouseButtonEvent & event) {}
+
+	inline void Window::MouseReleased(const MouseButtonEvent & event) {}
+
+	inline void Window::MouseEntered() {}
+
+	inline void Window::MouseExited() {}
+
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	//--------------GRAPHICAL OBJECT CLASS------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	GraphicalObject::GraphicalObject(ObjectWindow* window, Color color)
+		: window_(window), color_(color), filled_(false), id_(id_source_++),
+		in_window_(false), order_(0), query_stamp_(0), shape_(0), slot_(0),
+		object_index_(0), pool_slot_(kNoPoolSlot), body_(kNoBody), layer_(0) {
+		rect_ = SDL_Rect{ 0, 0, 0, 0 };
+	}
+
+	GraphicalObject::GraphicalObject(ObjectWindow* window, Color color, bool filled)
+		: window_(window), color_(color), filled_(filled), id_(id_source_++),
+		in_window_(false), order_(0), query_stamp_(0), shape_(0), slot_(0),
+		object_index_(0), pool_slot_(kNoPoolSlot), body_(kNoBody), layer_(0) {
+		rect_ = SDL_Rect{ 0, 0, 0, 0 };
+	}
+
+	GraphicalObject::GraphicalObject(ObjectWindow* window, Color color, int x,
+		int y)
+		: window_(window), color_(color), filled_(false), id_(id_source_++),
+		in_window_(false), order_(0), query_stamp_(0), shape_(0), slot_(0),
+		object_index_(0), pool_slot_(kNoPoolSlot), body_(kNoBody), layer_(0) {
+		rect_ = SDL_Rect{ x, y, 0, 0 };
+	}
+
+	GraphicalObject::~GraphicalObject() {}
+
+	void GraphicalObject::FontChanged() {}
+
+	int GraphicalObject::GetPosX() { return rect_.x; }
+
+	int GraphicalObject::GetPosY() { return rect_.y; }
+
+	void GraphicalObject::SetPosX(int x) {
+		SDL_Rect old_rect = rect_;
+		rect_.x = x;
+		Changed(old_rect);
+	}
+
+	void GraphicalObject::SetPosY(int y) {
+		SDL_Rect old_rect = rect_;
+		rect_.y = y;
+		Changed(old_rect);
+	}
+
+	int GraphicalObject::GetWidth()
+	{
+		return rect_.w;
+	}
+
+	int GraphicalObject::GetHeight()
+	{
+		return rect_.h;
+	}
+
+	void GraphicalObject::SetWidth(int width)
+	{
+		SDL_Rect old_rect = rect_;
+		rect_.w = width;
+		Changed(old_rect);
+	}
+
+	void GraphicalObject::SetHeight(int height)
+	{
+		SDL_Rect old_rect = rect_;
+		rect_.h = height;
+		Changed(old_rect);
+	}
+
+	void GraphicalObject::SetFilled(bool filled)
+	{
+		filled_ = filled;
+		Changed(rect_);
+	}
+
+	void GraphicalObject::Changed(const SDL_Rect& old_rect)
+	{
+		if (in_window_)
+			window_->ObjectChanged(this, old_rect);
+	}
+
+	bool GraphicalObject::Hit(int x, int y)
+	{
+		if (x >= rect_.x &&
+			x <= rect_.x + rect_.w &&
+			y >= rect_.y &&
+			y <= rect_.y + rect_.h)
+		{
+			return true;
+		}
+
+		return false;
+	}
+
+	bool GraphicalObject::Collision(GraphicalObject* obj)
+	{
+		//collision code written from scratch (no outside sources consulted, so it may have bugs)
+		GraphicalObject* rect1 = this;
+		GraphicalObject* rect2 = obj;
+
+		if (rect1->GetPosX() + rect1->GetWidth() >= rect2->GetPosX() &&
+			rect1->GetPosX() <= rect2->GetPosX() + rect2->GetWidth() &&
+			rect1->GetPosY() + rect1->GetHeight() >= rect2->GetPosY() &&
+			rect1->GetPosY() <= rect2->GetPosY() + rect2->GetHeight()) {
+			return true;
+		}
+
+		return false;
+	}
+
+	void GraphicalObject::SetVelocity(float vx, float vy)
+	{
+		if (!in_window_)
+			return;
+		BodyArrays& bodies = window_->bodies_;
+		if (body_ == kNoBody)
+			bodies.Append(this);
+		bodies.vx[body_] = vx;
+		bodies.vy[body_] = vy;
+	}
+
+	float GraphicalObject::GetVelocityX()
+	{
+		return body_ == kNoBody ? 0.0f : window_->bodies_.vx[body_];
+	}
+
+	float GraphicalObject::GetVelocityY()
+	{
+		return body_ == kNoBody ? 0.0f : window_->bodies_.vy[body_];
+	}
+
+	bool GraphicalObject::HasBody() { return body_ != kNoBody; }
+
+	void GraphicalObject::RemoveBody()
+	{
+		if (body_ != kNoBody)
+			window_->bodies_.Erase(body_);
+	}
+
+	float GraphicalObject::GetExactPosX()
+	{
+		return body_ == kNoBody ? (float)rect_.x : window_->bodies_.x[body_];
+	}
+
+	float GraphicalObject::GetExactPosY()
+	{
+		return body_ == kNoBody ? (float)rect_.y : window_->bodies_.y[body_];
+	}
+
+	void GraphicalObject::SetExactPos(float x, float y)
+	{
+		SDL_Rect old_rect = rect_;
+		rect_.x = (int)std::floor(x);
+		rect_.y = (int)std::floor(y);
+		if (body_ != kNoBody) {
+			window_->bodies_.x[body_] = x;
+			window_->bodies_.y[body_] = y;
+		}
+		Changed(old_rect);
+	}
+
+	unsigned GraphicalObject::id_source_ = 0;
+	const Uint32 GraphicalObject::kNoPoolSlot;
+	const Uint32 GraphicalObject::kNoBody;
+
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	//--------------POINT CLASS-----------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	Point::Point(ObjectWindow* window, Color color, int x, int y)
+		: GraphicalObject(window, color, x, y) {}
+
+	void Point::Paint() { window_->GetDrawList().AddPoint(color_, rect_.x, rect_.y); }
+
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	//--------------RECTANGLE CLASS-------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	Rectangle::Rectangle(ObjectWindow* window, Color color, int x, int y, int width,
+		int height)
+		: GraphicalObject(window, color) {
+		rect_.x = x;
+		rect_.y = y;
+		rect_.w = width;
+		rect_.h = height;
+	}
+
+	Rectangle::Rectangle(ObjectWindow * window, Color color, int x, int y, int width, int height, bool filled) : GraphicalObject(window, color, filled)
+	{
+		rect_.x = x;
+		rect_.y = y;
+		rect_.w = width;
+		rect_.h = height;
+	}
+
+	void Rectangle::Paint() {
+		window_->GetDrawList().AddRectangle(color_, rect_, filled_);
+	}
+
+
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	//--------------CIRCLE CLASS----------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	Circle::Circle(ObjectWindow* window, Color color, int x, int y, int radius) : GraphicalObject(window, color, x, y)
+	{
+		rect_.w = radius * 2;
+		rect_.h = radius * 2;
+	}
+
+	Circle::Circle(ObjectWindow * window, Color color, int x, int y, int radius, bool filled) : GraphicalObject(window, color, filled)
+	{
+		rect_.x = x;
+		rect_.y = y;
+		rect_.w = radius * 2;
+		rect_.h = radius * 2;
+	}
+
+	void Circle::SetRadius(int radius)
+	{
+		SDL_Rect old_rect = rect_;
+		rect_.w = radius * 2;
+		rect_.h = radius * 2;
+		Changed(old_rect);
+	}
+
+	void Circle::Paint()
+	{
+		int radius = rect_.w / 2;
+		window_->GetDrawList().AddCircle(color_, rect_.x + radius, rect_.y + radius, radius, filled_);
+	}
+
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	//--------------SPLINE CLASS----------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	const int Spline::kMaxDepth;
+	constexpr double Spline::kTolerance;
+
+	// The point at t in [0, 1] on the uniform Catmull-Rom segment from
+	// p[1] to p[2], shaped by their neighbors p[0] and p[3].
+	static void CatmullRom(const SDL_Point* p, double t, double& x, double& y) {
+		double t2 = t * t, t3 = t2 * t;
+		x = 0.5 * (2.0 * p[1].x + (p[2].x - p[0].x) * t
+			+ (2.0 * p[0].x - 5.0 * p[1].x + 4.0 * p[2].x - p[3].x) * t2
+			+ (3.0 * (p[1].x - p[2].x) + p[3].x - p[0].x) * t3);
+		y = 0.5 * (2.0 * p[1].y + (p[2].y - p[0].y) * t
+			+ (2.0 * p[0].y - 5.0 * p[1].y + 4.0 * p[2].y - p[3].y) * t2
+			+ (3.0 * (p[1].y - p[2].y) + p[3].y - p[0].y) * t3);
+	}
+
+	// Appends the vertices after (x0, y0) of the curve between t0 and t1,
+	// halving it while its middle lies further from the chord than the
+	// tolerance.  The first halving is unconditional, as an S bend can
+	// cross its chord right at the middle.
+	static void SubdivideSpline(const SDL_Point* p, double t0, double x0, double y0,
+		double t1, double x1, double y1, int depth, vector<SDL_Point>& vertices) {
+		double t = (t0 + t1) / 2.0, x, y;
+		CatmullRom(p, t, x, y);
+		// Squared distance from the chord's line, or from its start if it
+		// has no length
+		double chord_x = x1 - x0, chord_y = y1 - y0;
+		double chord2 = chord_x * chord_x + chord_y * chord_y;
+		double cross = (x - x0) * chord_y - (y - y0) * chord_x;
+		double error2 = chord2 > 0.0 ? cross * cross / chord2
+			: (x - x0) * (x - x0) + (y - y0) * (y - y0);
+		if (depth == 0 || (depth < Spline::kMaxDepth &&
+			error2 > Spline::kTolerance * Spline::kTolerance)) {
+			SubdivideSpline(p, t0, x0, y0, t, x, y, depth + 1, vertices);
+			SubdivideSpline(p, t, x, y, t1, x1, y1, depth + 1, vertices);
+			return;
+		}
+		SDL_Point end{ (int)std::lround(x1), (int)std::lround(y1) };
+		if (end.x != vertices.back().x || end.y != vertices.back().y)
+			vertices.push_back(end);
+	}
+
+	Spline::Spline(ObjectWindow* window, Color color, const SDL_Point* points, size_t count)
+		: GraphicalObject(window, color), control_points_(points, points + count) {
+		Tessellate();
+	}
+
+	void Spline::Tessellate() {
+		SDL_Rect old_rect = rect_;
+		vertices_.clear();
+		size_t count = control_points_.size();
+		if (count > 0)
+			vertices_.push_back(control_points_[0]);
+		for (size_t i = 0; i + 1 < count; i++) {
+			// The end points stand in for their missing neighbors
+			SDL_Point segment[4] = { control_points_[i > 0 ? i - 1 : 0], control_points_[i],
+				control_points_[i + 1], control_points_[i + 2 < count ? i + 2 : i + 1] };
+			SubdivideSpline(segment, 0.0, segment[1].x, segment[1].y,
+				1.0, segment[2].x, segment[2].y, 0, vertices_);
+		}
+
+		// The rect's corner becomes the top left of the curve's bounds
+		int left = 0, top = 0, right = 0, bottom = 0;
+		if (!vertices_.empty()) {
+			left = right = vertices_[0].x;
+			top = bottom = vertices_[0].y;
+		}
+		for (const SDL_Point& vertex : vertices_) {
+			left = std::min(left, vertex.x);
+			top = std::min(top, vertex.y);
+			right = std::max(right, vertex.x);
+			bottom = std::max(bottom, vertex.y);
+		}
+		for (SDL_Point& vertex : vertices_) {
+			vertex.x -= left;
+			vertex.y -= top;
+		}
+		for (SDL_Point& point : control_points_) {
+			point.x -= left;
+			point.y -= top;
+		}
+		rect_ = SDL_Rect{ rect_.x + left, rect_.y + top, right - left, bottom - top };
+		Changed(old_rect);
+	}
+
+	size_t Spline::GetControlPointCount() const { return control_points_.size(); }
+
+	SDL_Point Spline::GetControlPoint(size_t i) const {
+		return SDL_Point{ control_points_[i].x + rect_.x, control_points_[i].y + rect_.y };
+	}
+
+	void Spline::SetControlPoint(size_t i, int x, int y) {
+		control_points_[i] = SDL_Point{ x - rect_.x, y - rect_.y };
+		Tessellate();
+	}
+
+	void Spline::SetControlPoints(const SDL_Point* points, size_t count) {
+		control_points_.resize(count);
+		for (size_t i = 0; i < count; i++)
+			control_points_[i] = SDL_Point{ points[i].x - rect_.x, points[i].y - rect_.y };
+		Tessellate();
+	}
+
+	void Spline::AddControlPoint(int x, int y) {
+		control_points_.push_back(SDL_Point{ x - rect_.x, y - rect_.y });
+		Tessellate();
+	}
+
+	const vector<SDL_Point>& Spline::GetVertices() const { return vertices_; }
+
+	void Spline::Paint() {
+		DrawList& draw_list = window_->GetDrawList();
+		if (vertices_.size() == 1)
+			draw_list.AddPoint(color_, rect_.x, rect_.y);
+		else
+			draw_list.AddPolyline(color_, vertices_.data(), vertices_.size(), rect_.x, rect_.y);
+	}
+
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	//--------------TEXT CLASS------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	Text::Text(ObjectWindow* window, Color color, int x, int y, const string& text, int scale)
+		: GraphicalObject(window, color, x, y), text_(text), scale_(scale), font_(nullptr) {
+		Layout();
+	}
+
+	void Text::Layout() {
+		SDL_Rect old_rect = rect_;
+		glyphs_.clear();
+		font_ = &window_->GetFont();
+		SDL_Point size = font_->Layout(text_, scale_, glyphs_);
+		rect_.w = size.x;
+		rect_.h = size.y;
+		Changed(old_rect);
+	}
+
+	void Text::FontChanged() {
+		if (font_ != &window_->GetFont())
+			Layout();
+	}
+
+	const string& Text::GetText() const { return text_; }
+
+	void Text::SetText(const string& text) {
+		if (text == text_)
+			return;
+		text_ = text;
+		Layout();
+	}
+
+	int Text::GetScale() const { return scale_; }
+
+	void Text::SetScale(int scale) {
+		if (scale == scale_)
+			return;
+		scale_ = scale;
+		Layout();
+	}
+
+	void Text::Paint() {
+		window_->GetDrawList().AddGlyphs(color_, glyphs_.data(), glyphs_.size(), rect_.x, rect_.y);
+	}
+
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	//--------------SPRITE CLASS----------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	Sprite::Sprite(ObjectWindow* window, const SpriteImage& image, int x, int y)
+		: Sprite(window, image, x, y, Color::kWhite) {}
+
+	Sprite::Sprite(ObjectWindow* window, const SpriteImage& image, int x, int y, Color tint)
+		: GraphicalObject(window, tint, x, y), image_(image) {
+		rect_.w = image.source.w;
+		rect_.h = image.source.h;
+	}
+
+	const SpriteImage& Sprite::GetImage() const { return image_; }
+
+	void Sprite::SetImage(const SpriteImage& image) {
+		image_ = image;
+		Changed(rect_);
+	}
+
+	Color Sprite::GetTint() const { return color_; }
+
+	void Sprite::SetTint(Color tint) {
+		color_ = tint;
+		Changed(rect_);
+	}
+
+	void Sprite::Paint() {
+		window_->GetDrawList().AddSprite(image_, rect_, color_);
+	}
+
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	//--------------SPATIAL GRID CLASS----------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	// Rounds toward negative infinity so that cells left of and above the
+	// origin are as wide as every other cell.
+	static int FloorDiv(int a, int b) {
+		return a >= 0 ? a / b : -((-a + b - 1) / b);
+	}
+
+	static Uint64 CellKey(int cell_x, int cell_y) {
+		return ((Uint64)(Uint32)cell_x << 32) | (Uint32)cell_y;
+	}
+
+	static void EraseUnordered(vector<GraphicalObject*>& objects, GraphicalObject* obj) {
+		auto it = std::find(objects.begin(), objects.end(), obj);
+		if (it == objects.end())
+			return;
+		*it = objects.back();
+		objects.pop_back();
+	}
+
+	const int SpatialGrid::kDefaultCellSize;
+	const int SpatialGrid::kMaxCellsPerObject;
+
+	SpatialGrid::SpatialGrid(int cell_size)
+		: cell_size_(cell_size > 0 ? cell_size : kDefaultCellSize), stamp_(0), extent_{ 0, 0, 0, 0 } {}
+
+	int SpatialGrid::GetCellSize() const { return cell_size_; }
+
+	// Object edges are inclusive (see GraphicalObject::Hit), so a rect
+	// touches the cell containing x + w as well.
+	void SpatialGrid::CellRange(const SDL_Rect& rect, int& x0, int& y0, int& x1, int& y1) const {
+		x0 = FloorDiv(rect.x, cell_size_);
+		y0 = FloorDiv(rect.y, cell_size_);
+		x1 = FloorDiv(rect.x + std::max(rect.w, 0), cell_size_);
+		y1 = FloorDiv(rect.y + std::max(rect.h, 0), cell_size_);
+	}
+
+	void SpatialGrid::Insert(GraphicalObject* obj, const SDL_Rect& rect) {
+		int x0, y0, x1, y1;
+		CellRange(rect, x0, y0, x1, y1);
+		SDL_Rect cells{ x0 * cell_size_, y0 * cell_size_, (x1 - x0 + 1) * cell_size_, (y1 - y0 + 1) * cell_size_ };
+		extent_ = extent_.w ? RectUnion(extent_, cells) : cells;
+		if ((long long)(x1 - x0 + 1) * (y1 - y0 + 1) > kMaxCellsPerObject) {
+			oversized_.push_back(obj);
+			return;
+		}
+		for (int cell_y = y0; cell_y <= y1; cell_y++)
+			for (int cell_x = x0; cell_x <= x1; cell_x++)
+				cells_[CellKey(cell_x, cell_y)].push_back(obj);
+	}
+
+	void SpatialGrid::Remove(GraphicalObject* obj, const SDL_Rect& rect) {
+		int x0, y0, x1, y1;
+		CellRange(rect, x0, y0, x1, y1);
+		if ((long long)(x1 - x0 + 1) * (y1 - y0 + 1) > kMaxCellsPerObject) {
+			EraseUnordered(oversized_, obj);
+			return;
+		}
+		for (int cell_y = y0; cell_y <= y1; cell_y++) {
+			for (int cell_x = x0; cell_x <= x1; cell_x++) {
+				auto cell = cells_.find(CellKey(cell_x, cell_y));
+				if (cell == cells_.end())
+					continue;
+				EraseUnordered(cell->second, obj);
+				if (cell->second.empty())
+					cells_.erase(cell);
+			}
+		}
+	}
+
+	void SpatialGrid::Move(GraphicalObject* obj, const SDL_Rect& old_rect, const SDL_Rect& new_rect) {
+		int old_x0, old_y0, old_x1, old_y1, new_x0, new_y0, new_x1, new_y1;
+		CellRange(old_rect, old_x0, old_y0, old_x1, old_y1);
+		CellRange(new_rect, new_x0, new_y0, new_x1, new_y1);
+		if (old_x0 == new_x0 && old_y0 == new_y0 && old_x1 == new_x1 && old_y1 == new_y1)
+			return;
+		Remove(obj, old_rect);
+		Insert(obj, new_rect);
+	}
+
+	void SpatialGrid::Query(const SDL_Rect& area, vector<GraphicalObject*>& results) {
+		if (++stamp_ == 0) {
+			// The stamp wrapped; forget every old visit so none is mistaken
+			// for one made by this query.
+			for (auto& cell : cells_)
+				for (GraphicalObject* obj : cell.second)
+					obj->query_stamp_ = 0;
+			for (GraphicalObject* obj : oversized_)
+				obj->query_stamp_ = 0;
+			stamp_ = 1;
+		}
+		auto visit = [&](const vector<GraphicalObject*>& objects) {
+			for (GraphicalObject* obj : objects) {
+				if (obj->query_stamp_ != stamp_) {
+					obj->query_stamp_ = stamp_;
+					results.push_back(obj);
+				}
+			}
+		};
+
+		int x0, y0, x1, y1;
+		CellRange(area, x0, y0, x1, y1);
+		if ((long long)(x1 - x0 + 1) * (y1 - y0 + 1) > (long long)cells_.size()) {
+			// Cheaper to walk the occupied cells than the covered ones
+			for (auto& cell : cells_) {
+				int cell_x = (int)(Sint32)(cell.first >> 32);
+				int cell_y = (int)(Sint32)(cell.first & 0xFFFFFFFF);
+				if (cell_x >= x0 && cell_x <= x1 && cell_y >= y0 && cell_y <= y1)
+					visit(cell.second);
+			}
+		}
+		else {
+			for (int cell_y = y0; cell_y <= y1; cell_y++) {
+				for (int cell_x = x0; cell_x <= x1; cell_x++) {
+					auto cell = cells_.find(CellKey(cell_x, cell_y));
+					if (cell != cells_.end())
+						visit(cell->second);
+				}
+			}
+		}
+		visit(oversized_);
+	}
+
+	SDL_Rect SpatialGrid::GetExtent() const { return extent_; }
+
+	void SpatialGrid::Clear() {
+		cells_.clear();
+		oversized_.clear();
+		extent_ = SDL_Rect{ 0, 0, 0, 0 };
+	}
+
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	//--------------SHAPE ARRAYS CLASS----------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	ShapeArrays::ShapeArrays() : erased(0) {}
+
+	void ShapeArrays::Append(GraphicalObject* obj, ShapeKind kind) {
+		obj->shape_ = (int)kind;
+		obj->slot_ = object.size();
+		x.push_back(obj->rect_.x);
+		y.push_back(obj->rect_.y);
+		w.push_back(obj->rect_.w);
+		h.push_back(obj->rect_.h);
+		color.push_back(obj->color_);
+		filled.push_back(obj->filled_);
+		order.push_back(obj->order_);
+		layer.push_back(obj->layer_);
+		object.push_back(obj);
+	}
+
+	void ShapeArrays::Store(const GraphicalObject* obj) {
+		size_t i = obj->slot_;
+		x[i] = obj->rect_.x;
+		y[i] = obj->rect_.y;
+		w[i] = obj->rect_.w;
+		h[i] = obj->rect_.h;
+		color[i] = obj->color_;
+		filled[i] = obj->filled_;
+		layer[i] = obj->layer_;
+	}
+
+	void ShapeArrays::Erase(size_t slot) {
+		object[slot] = nullptr;
+		erased++;
+		if (erased >= ObjectWindow::kMinCompaction && erased * 2 > object.size())
+			Compact();
+	}
+
+	void ShapeArrays::Compact() {
+		size_t kept = 0;
+		for (size_t i = 0; i < object.size(); i++) {
+			if (!object[i])
+				continue;
+			x[kept] = x[i];
+			y[kept] = y[i];
+			w[kept] = w[i];
+			h[kept] = h[i];
+			color[kept] = color[i];
+			filled[kept] = filled[i];
+			order[kept] = order[i];
+			layer[kept] = layer[i];
+			object[kept] = object[i];
+			object[kept]->slot_ = kept;
+			kept++;
+		}
+		x.resize(kept);
+		y.resize(kept);
+		w.resize(kept);
+		h.resize(kept);
+		color.erase(color.begin() + kept, color.end());
+		filled.resize(kept);
+		order.resize(kept);
+		layer.resize(kept);
+		object.resize(kept);
+		erased = 0;
+	}
+
+	void ShapeArrays::Clear() {
+		x.clear();
+		y.clear();
+		w.clear();
+		h.clear();
+		color.clear();
+		filled.clear();
+		order.clear();
+		layer.clear();
+		object.clear();
+		erased = 0;
+	}
+
+	size_t ShapeArrays::Size() const { return object.size(); }
+
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	//--------------BODY ARRAYS CLASS-----------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	void BodyArrays::Append(GraphicalObject* obj) {
+		obj->body_ = (Uint32)object.size();
+		x.push_back((float)obj->rect_.x);
+		y.push_back((float)obj->rect_.y);
+		vx.push_back(0.0f);
+		vy.push_back(0.0f);
+		object.push_back(obj);
+	}
+
+	void BodyArrays::Erase(size_t index) {
+		size_t last = object.size() - 1;
+		object[index]->body_ = GraphicalObject::kNoBody;
+		if (index != last) {
+			x[index] = x[last];
+			y[index] = y[last];
+			vx[index] = vx[last];
+			vy[index] = vy[last];
+			object[index] = object[last];
+			object[index]->body_ = (Uint32)index;
+		}
+		x.pop_back();
+		y.pop_back();
+		vx.pop_back();
+		vy.pop_back();
+		object.pop_back();
+	}
+
+	void BodyArrays::Integrate(float dt) {
+		float* px = x.data();
+		float* py = y.data();
+		const float* pvx = vx.data();
+		const float* pvy = vy.data();
+		size_t i = 0, n = object.size();
+#if SGL2_AVX2
+		__m256 dt8 = _mm256_set1_ps(dt);
+		for (; i + 8 <= n; i += 8) {
+			_mm256_storeu_ps(px + i, _mm256_add_ps(_mm256_loadu_ps(px + i),
+				_mm256_mul_ps(_mm256_loadu_ps(pvx + i), dt8)));
+			_mm256_storeu_ps(py + i, _mm256_add_ps(_mm256_loadu_ps(py + i),
+				_mm256_mul_ps(_mm256_loadu_ps(pvy + i), dt8)));
+		}
+#endif
+#if SGL2_SSE2
+		__m128 dt4 = _mm_set1_ps(dt);
+		for (; i + 4 <= n; i += 4) {
+			_mm_storeu_ps(px + i, _mm_add_ps(_mm_loadu_ps(px + i), _mm_mul_ps(_mm_loadu_ps(pvx + i), dt4)));
+			_mm_storeu_ps(py + i, _mm_add_ps(_mm_loadu_ps(py + i), _mm_mul_ps(_mm_loadu_ps(pvy + i), dt4)));
+		}
+#endif
+		for (; i < n; i++) {
+			px[i] += pvx[i] * dt;
+			py[i] += pvy[i] * dt;
+		}
+	}
+
+	void BodyArrays::Clear() {
+		for (GraphicalObject* obj : object)
+			obj->body_ = GraphicalObject::kNoBody;
+		x.clear();
+		y.clear();
+		vx.clear();
+		vy.clear();
+		object.clear();
+	}
+
+	size_t BodyArrays::Size() const { return object.size(); }
+
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	//--------------HANDLE CLASS----------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	template <typename T>
+	Handle<T>::Handle(Uint32 index, Uint32 generation)
+		: index_(index), generation_(generation) {}
+
+	template <typename T>
+	Handle<T>::Handle() : index_(0), generation_(0) {}
+
+	template <typename T>
+	template <typename U>
+	Handle<T>::Handle(const Handle<U>& other)
+		: index_(other.index_), generation_(other.generation_) {
+		static_assert(std::is_base_of<T, U>::value, "handles only convert to a base type");
+	}
+
+	template <typename T>
+	bool Handle<T>::IsNull() const { return generation_ == 0; }
+
+	template <typename T>
+	bool Handle<T>::operator==(const Handle& other) const {
+		return index_ == other.index_ && generation_ == other.generation_;
+	}
+
+	template <typename T>
+	bool Handle<T>::operator!=(const Handle& other) const { return !(*this == other); }
+
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	//--------------OBJECT POOL CLASS-----------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	const size_t ObjectPool::kChunkSize;
+
+	template <typename T>
+	ObjectPool::Arena<T>::Arena() : used_(kChunkSize) {}
+
+	template <typename T>
+	void* ObjectPool::Arena<T>::Allocate() {
+		if (!free_.empty()) {
+			void* memory = free_.back();
+			free_.pop_back();
+			return memory;
+		}
+		if (used_ == kChunkSize) {
+			chunks_.emplace_back(new Storage[kChunkSize]);
+			used_ = 0;
+		}
+		return &chunks_.back()[used_++];
+	}
+
+	template <typename T>
+	void ObjectPool::Arena<T>::Destroy(GraphicalObject* obj) {
+		T* object = static_cast<T*>(obj);
+		object->~T();
+		free_.push_back(object);
+	}
+
+	ObjectPool::ObjectPool() : size_(0) {}
+
+	ObjectPool::~ObjectPool() { Clear(); }
+
+	template <typename T, typename... Args>
+	Handle<T> ObjectPool::Create(Args&&... args) {
+		static_assert(std::is_base_of<GraphicalObject, T>::value,
+			"pools only hold GraphicalObjects");
+		std::unique_ptr<ArenaBase>& arena = arenas_[std::type_index(typeid(T))];
+		if (!arena)
+			arena.reset(new Arena<T>());
+		Arena<T>* typed_arena = static_cast<Arena<T>*>(arena.get());
+		void* memory = typed_arena->Allocate();
+		T* obj = new (memory) T(std::forward<Args>(args)...);
+
+		Uint32 index;
+		if (free_slots_.empty()) {
+			index = (Uint32)slots_.size();
+			slots_.push_back(Slot{ nullptr, nullptr, 1 });
+		}
+		else {
+			index = free_slots_.back();
+			free_slots_.pop_back();
+		}
+		slots_[index].object = obj;
+		slots_[index].arena = typed_arena;
+		obj->pool_slot_ = index;
+		size_++;
+		return Handle<T>(index, slots_[index].generation);
+	}
+
+	template <typename T>
+	T* ObjectPool::Get(const Handle<T>& handle) const {
+		if (handle.index_ >= slots_.size())
+			return nullptr;
+		const Slot& slot = slots_[handle.index_];
+		if (slot.generation != handle.generation_ || !slot.object)
+			return nullptr;
+		return static_cast<T*>(slot.object);
+	}
+
+	Handle<GraphicalObject> ObjectPool::GetHandle(const GraphicalObject* obj) const {
+		if (!obj || obj->pool_slot_ >= slots_.size() || slots_[obj->pool_slot_].object != obj)
+			return Handle<GraphicalObject>();
+		return Handle<GraphicalObject>(obj->pool_slot_, slots_[obj->pool_slot_].generation);
+	}
+
+	bool ObjectPool::Destroy(const Handle<GraphicalObject>& handle) {
+		GraphicalObject* obj = Get(handle);
+		if (!obj)
+			return false;
+		Slot& slot = slots_[handle.index_];
+		slot.arena->Destroy(obj);
+		slot.object = nullptr;
+		slot.arena = nullptr;
+		// Generation 0 is reserved for null handles
+		if (++slot.generation == 0)
+			slot.generation = 1;
+		free_slots_.push_back(handle.index_);
+		size_--;
+		return true;
+	}
+
+	void ObjectPool::Clear() {
+		for (Uint32 index = 0; index < slots_.size(); index++)
+			if (slots_[index].object)
+				Destroy(Handle<GraphicalObject>(index, slots_[index].generation));
+	}
+
+	size_t ObjectPool::Size() const { return size_; }
+
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	//--------------OBJECT WINDOW CLASS---------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+	//------------------------------------------------------//
+
+	ObjectWindow::ObjectWindow(const string& title, int width, int height,
+		const Color& background)
+		: ObjectWindow(title, width, height, background, WindowMode::kShown) {}
+
+	ObjectWindow::ObjectWindow(const string& title, int width, int height,
+		const Color& background, WindowMode mode)
+		: Window(title, width, height, background, mode), removed_objects_(0), draw_sorting_(true),
+		next_order_(0), sweep_dirty_(true), damage_tracking_(false),
+		full_damage_(true), canvas_(nullptr), canvas_background_(background),
+		storage_(ObjectStorage::kObjects), tile_size_(kDefaultTileSize), camera_{ 0.0f, 0.0f, 1.0f },
+		layers_(1, Layer{ kDefaultLayer, 0, LayerMode::kDynamic, nullptr, false }), layer_order_(1, 0),
+		layer_caching_(true) {}
+
+	ObjectWindow::~ObjectWindow() {
+		if (canvas_)
+			SDL_DestroyTexture(canvas_);
+		for (Layer& layer : layers_)
+			if (layer.cache)
+				SDL_DestroyTexture(layer.cache);
+	}
+
+	const size_t ObjectWindow::kMaxDamageRects;
+	const size_t ObjectWindow::kMinCompaction;
+	const int ObjectWindow::kDefaultTileSize;
+	constexpr float ObjectWindow::kMinZoom;
+	const string ObjectWindow::kDefaultLayer = "default";
+
+	// Pixels an object may touch when painted: a rect outline covers
+	// x..x + w - 1, but a circle of width 2r covers x..x + 2r and a point
+	// has no width at all, so one extra row and column is included.
+	static SDL_Rect PaintBounds(const SDL_Rect& rect) {
+		return SDL_Rect{ rect.x, rect.y, std::max(rect.w, 0) + 1, std::max(rect.h, 0) + 1 };
+	}
+
+	void ObjectWindow::PrePaint() {
+		// The draw list belongs to the simulation thread of a pipelined Run
+		if (pipeline_) {
+			// The canvas misses the snapshots, so the next frame after the Run
+			// repaints all of it
+			full_damage_ = true;
+			ClearFrame(snapshots_->Front().background);
+			return;
+		}
+		draw_list_.Clear();
+		UpdateLayerCaches();
+		if (damage_tracking_ && !HasCanvas()) {
+			if (SDL_RenderTargetSupported(renderer_)) {
+				canvas_ = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_ARGB8888,
+					SDL_TEXTUREACCESS_TARGET, width_, height_);
+				if (canvas_)
+					SDL_SetTextureBlendMode(canvas_, SDL_BLENDMODE_NONE);
+			}
+			full_damage_ = true;
+		}
+		if (!damage_tracking_ || !HasCanvas()) {
+			Window::PrePaint();
+			return;
+		}
+
+		if (canvas_background_ != background_color_) {
+			canvas_background_ = background_color_;
+			full_damage_ = true;
+		}
+		if (full_damage_) {
+			damage_.assign(1, SDL_Rect{ 0, 0, width_, height_ });
+			full_damage_ = false;
+		}
+
+		// The damage is replaced with the background, not blended onto
+		FlushPoints();
+		SetDrawColor(background_color_);
+		if (backend_ == RenderBackend::kSoftware)
+			raster_.ClearRects(damage_.data(), damage_.size(), background_color_);
+		else {
+			SDL_SetRenderTarget(renderer_, canvas_);
+			SDL_SetRenderDrawBlendMode(renderer_, SDL_BLENDMODE_NONE);
+			SDL_RenderFillRects(renderer_, damage_.data(), (int)damage_.size());
+			SDL_SetRenderDrawBlendMode(renderer_, SDL_BLENDMODE_BLEND);
+		}
+		counters_.draw_calls++;
+
+		// Paint() may draw anywhere inside the damage
+		SDL_Rect bounds = damage_.empty() ? SDL_Rect{ 0, 0, 0, 0 } : damage_[0];
+		for (const SDL_Rect& rect : damage_)
+			bounds = RectUnion(bounds, rect);
+		SetClipRect(&bounds);
+	}
+
+	void ObjectWindow::Paint() {}
+
+	void ObjectWindow::PostPaint() {
+		if (pipeline_) {
+			const SceneSnapshot& snapshot = snapshots_->Front();
+			counters_.objects_painted += snapshot.objects;
+			if (workers_ && backend_ == RenderBackend::kSoftware)
+				DrawCommandsTiled(snapshot.draw_list, SDL_Rect{ 0, 0, width_, height_ });
+			else
+				DrawCommands(snapshot.draw_list);
+			Window::PostPaint();
+			return;
+		}
+		if (!damage_tracking_ || !HasCanvas()) {
+			DrawLayers(SDL_Rect{ 0, 0, width_, height_ });
+			Window::PostPaint();
+			return;
+		}
+
+		// Whatever Paint() recorded goes underneath the objects
+		draw_list_.ApplyCamera(camera_, SDL_Rect{ 0, 0, width_, height_ });
+		draw_list_.Sort(draw_sorting_);
+		DrawCommands(draw_list_);
+		for (const SDL_Rect& rect : damage_)
+			PaintRegion(rect);
+		damage_.clear();
+
+		FlushPoints();
+		SetClipRect(nullptr);
+		// The software framebuffer is the canvas and is uploaded as it is
+		if (backend_ == RenderBackend::kRenderer) {
+			SDL_SetRenderTarget(renderer_, nullptr);
+			SDL_RenderCopy(renderer_, canvas_, nullptr, nullptr);
+			counters_.draw_calls++;
+		}
+		Window::PostPaint();
+	}
+
+	SDL_Rect ObjectWindow::ScreenBounds(const SDL_Rect& rect) const {
+		SDL_Rect bounds = PaintBounds(rect);
+		if (camera_.x == 0.0f && camera_.y == 0.0f && camera_.zoom == 1.0f)
+			return bounds;
+		// Rounding the zoomed shape may reach a pixel past its edges
+		int left = CameraToScreen(bounds.x, camera_.x, camera_.zoom) - 1;
+		int top = CameraToScreen(bounds.y, camera_.y, camera_.zoom) - 1;
+		int right = CameraToScreen((double)bounds.x + bounds.w, camera_.x, camera_.zoom) + 2;
+		int bottom = CameraToScreen((double)bounds.y + bounds.h, camera_.y, camera_.zoom) + 2;
+		return SDL_Rect{ left, top, right - left, bottom - top };
+	}
+
+	SDL_Rect ObjectWindow::WorldArea(const SDL_Rect& area) const {
+		double zoom = camera_.zoom;
+		double left = std::floor(area.x / zoom + camera_.x);
+		double top = std::floor(area.y / zoom + camera_.y);
+		double right = std::ceil((area.x + area.w) / zoom + camera_.x);
+		double bottom = std::ceil((area.y + area.h) / zoom + camera_.y);
+		auto clamp = [](double v) { return std::max(-1073741824.0, std::min(v, 1073741824.0)); };
+		left = clamp(left);
+		top = clamp(top);
+		return SDL_Rect{ (int)left, (int)top, (int)(clamp(right) - left), (int)(clamp(bottom) - top) };
+	}
+
+	unsigned ObjectWindow::RecordLayer(const SDL_Rect& area, unsigned layer) {
+		// A screen pixel spans 1 / zoom world units, and a zoomed shape may
+		// round out by one
+		SDL_Rect world = WorldArea(area);
+		int margin = (int)std::ceil(1.0 / camera_.zoom);
+		world = SDL_Rect{ world.x - margin, world.y - margin, world.w + 2 * margin, world.h + 2 * margin };
+
+		unsigned painted = 0;
+		bool layered = layers_.size() > 1;
+		auto visible = [&](GraphicalObject* o) {
+			return (!layered || o->layer_ == layer) && RectsOverlap(PaintBounds(o->rect_), world);
+		};
+		if (storage_ == ObjectStorage::kArrays)
+			painted = RecordShapeArrays(world, layer);
+		else {
+			SDL_Rect extent = grid_.GetExtent();
+			int left = std::max(world.x, extent.x), right = std::min(world.x + world.w, extent.x + extent.w);
+			int top = std::max(world.y, extent.y), bottom = std::min(world.y + world.h, extent.y + extent.h);
+			long long seen = left < right && top < bottom ? (long long)(right - left) * (bottom - top) : 0;
+			if (seen * 2 > (long long)extent.w * extent.h) {
+				for (auto& o : objects_) {
+					if (o && visible(o)) {
+						o->Paint();
+						painted++;
+					}
+				}
+			}
+			else {
+				candidates_.clear();
+				CollectCandidates(world);
+				FilterCandidates(visible);
+				for (GraphicalObject* o : candidates_) o->Paint();
+				painted = (unsigned)candidates_.size();
+			}
+		}
+		return painted;
+	}
+
+	unsigned ObjectWindow::RecordVisible(const SDL_Rect& area) {
+		unsigned painted = 0;
+		for (unsigned index : layer_order_)
+			painted += RecordLayer(area, index);
+		draw_list_.ApplyCamera(camera_, area);
+		return painted;
+	}
+
+	void ObjectWindow::PublishSnapshot() {
+		draw_list_.Clear();
+		unsigned painted = RecordVisible(SDL_Rect{ 0, 0, width_, height_ });
+		draw_list_.Sort(draw_sorting_);
+
+		// Swapping hands the back slot's buffers to the next recording
+		SceneSnapshot& snapshot = snapshots_->Back();
+		std::swap(snapshot.draw_list, draw_list_);
+		snapshot.background = background_color_;
+		snapshot.objects = painted;
+		snapshots_->Publish();
+	}
+
+	bool ObjectWindow::AcquireSnapshot() { return snapshots_->Acquire(); }
+
+	bool ObjectWindow::HasCanvas() const {
+		return backend_ == RenderBackend::kSoftware || canvas_ != nullptr;
+	}
+
+	void ObjectWindow::PaintRegion(const SDL_Rect& area) {
+		FlushPoints();
+		SetClipRect(&area);
+		draw_list_.Clear();
+		DrawLayers(area);
+	}
+
+	bool ObjectWindow::CachesLayers() const {
+#if SDL_VERSION_ATLEAST(2, 0, 6)
+		if (!layer_caching_ || backend_ != RenderBackend::kRenderer || pipeline_)
+			return false;
+		for (const Layer& layer : layers_)
+			if (layer.mode == LayerMode::kStatic)
+				return SDL_RenderTargetSupported(renderer_) == SDL_TRUE;
+#endif
+		return false;
+	}
+
+	void ObjectWindow::UpdateLayerCaches() {
+#if SDL_VERSION_ATLEAST(2, 0, 6)
+		if (!CachesLayers())
+			return;
+		SDL_Rect screen{ 0, 0, width_, height_ };
+		SDL_Texture* target = nullptr;
+		bool switched = false;
+		for (unsigned index = 0; index < layers_.size(); index++) {
+			Layer& layer = layers_[index];
+			if (layer.mode != LayerMode::kStatic || (layer.cache && !layer.dirty))
+				continue;
+			if (!layer.cache) {
+				layer.cache = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_ARGB8888,
+					SDL_TEXTUREACCESS_TARGET, width_, height_);
+				if (!layer.cache)
+					continue;
+				// Blending onto transparency leaves colors premultiplied by
+				// alpha, so the cache is composited as such
+				SDL_BlendMode premultiplied = SDL_ComposeCustomBlendMode(
+					SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+					SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+				if (SDL_SetTextureBlendMode(layer.cache, premultiplied) != 0) {
+					SDL_DestroyTexture(layer.cache);
+					layer.cache = nullptr;
+					layer_caching_ = false;
+					break;
+				}
+			}
+			if (!switched) {
+				FlushPoints();
+				target = SDL_GetRenderTarget(renderer_);
+				switched = true;
+			}
+			SDL_SetRenderTarget(renderer_, layer.cache);
+			SetDrawColor(Color::kTransparent);
+			SDL_RenderClear(renderer_);
+			counters_.draw_calls++;
+			counters_.objects_painted += RecordLayer(screen, index);
+			draw_list_.ApplyCamera(camera_, screen);
+			draw_list_.Sort(draw_sorting_);
+			DrawCommands(draw_list_);
+			FlushPoints();
+			draw_list_.Clear();
+			layer.dirty = false;
+		}
+		if (switched)
+			SDL_SetRenderTarget(renderer_, target);
+#endif
+	}
+
+	void ObjectWindow::DrawLayers(const SDL_Rect& area) {
+		if (!CachesLayers()) {
+			counters_.objects_painted += RecordVisible(area);
+			draw_list_.Sort(draw_sorting_);
+			if (workers_ && backend_ == RenderBackend::kSoftware)
+				DrawCommandsTiled(draw_list_, area);
+			else
+				DrawCommands(draw_list_);
+			return;
+		}
+
+		// The dynamic layers between two cached ones are recorded and
+		// drawn together
+		auto flush = [&] {
+			if (draw_list_.Size() == 0)
+				return;
+			draw_list_.ApplyCamera(camera_, area);
+			draw_list_.Sort(draw_sorting_);
+			DrawCommands(draw_list_);
+			draw_list_.Clear();
+		};
+		for (unsigned index : layer_order_) {
+			const Layer& layer = layers_[index];
+			// A layer changed since UpdateLayerCaches is painted directly
+			if (layer.mode == LayerMode::kStatic && layer.cache && !layer.dirty) {
+				flush();
+				FlushPoints();
+				SDL_RenderCopy(renderer_, layer.cache, &area, &area);
+				counters_.draw_calls++;
+			}
+			else
+				counters_.objects_painted += RecordLayer(area, index);
+		}
+		flush();
+	}
+
+	void ObjectWindow::DrawCommandsTiled(const DrawList& draw_list, const SDL_Rect& area) {
+		FlushPoints();
+		const vector<DrawCommand>& commands = draw_list.Commands();
+		int left = std::max(area.x, 0), top = std::max(area.y, 0);
+		int right = std::min(area.x + area.w, width_);
+		int bottom = std::min(area.y + area.h, height_);
+		if (commands.empty() || left >= right || top >= bottom)
+			return;
+
+		// Tiles are aligned to the window so every region shares them
+		int tile_x0 = left / tile_size_, tile_y0 = top / tile_size_;
+		int tiles_x = (right - 1) / tile_size_ - tile_x0 + 1;
+		int tiles_y = (bottom - 1) / tile_size_ - tile_y0 + 1;
+		size_t tiles = (size_t)tiles_x * tiles_y;
+		if (tile_commands_.size() < tiles)
+			tile_commands_.resize(tiles);
+		for (size_t i = 0; i < tiles; i++)
+			tile_commands_[i].clear();
+
+		// Binning keeps list order within every tile
+		for (size_t i = 0; i < commands.size(); i++) {
+			const SDL_Rect& rect = commands[i].rect;
+			SDL_Rect bounds{ rect.x, rect.y, std::max(rect.w, 1), std::max(rect.h, 1) };
+			if (commands[i].kind == DrawKind::kCircle || commands[i].kind == DrawKind::kFilledCircle) {
+				// Circles reach radius pixels either side of their center,
+				// one past rect on an even size
+				int radius_x = rect.w / 2;
+				int radius_y = commands[i].kind == DrawKind::kCircle ? radius_x : rect.h / 2;
+				bounds = SDL_Rect{ rect.x, rect.y + rect.h / 2 - radius_y, 2 * radius_x + 1, 2 * radius_y + 1 };
+			}
+			int x0 = std::max(bounds.x, left), y0 = std::max(bounds.y, top);
+			int x1 = std::min(bounds.x + bounds.w, right) - 1;
+			int y1 = std::min(bounds.y + bounds.h, bottom) - 1;
+			if (x0 > x1 || y0 > y1)
+				continue;
+			for (int ty = y0 / tile_size_; ty <= y1 / tile_size_; ty++)
+				for (int tx = x0 / tile_size_; tx <= x1 / tile_size_; tx++)
+					tile_commands_[(size_t)(ty - tile_y0) * tiles_x + (tx - tile_x0)].push_back((Uint32)i);
+		}
+
+		workers_->ParallelFor(tiles, [&](size_t tile, unsigned thread) {
+			const vector<Uint32>& bin = tile_commands_[tile];
+			if (bin.empty())
+				return;
+			int tx = (int)(tile % tiles_x) + tile_x0, ty = (int)(tile / tiles_x) + tile_y0;
+			SDL_Rect clip{ tx * tile_size_, ty * tile_size_, tile_size_, tile_size_ };
+			int clip_right = std::min(clip.x + clip.w, right);
+			int clip_bottom = std::min(clip.y + clip.h, bottom);
+			clip.x = std::max(clip.x, left);
+			clip.y = std::max(clip.y, top);
+			clip.w = clip_right - clip.x;
+			clip.h = clip_bottom - clip.y;
+			for (Uint32 index : bin)
+				raster_.RasterizeCommand(commands[index], draw_list, *font_, sprites_, clip,
+					tile_spans_[thread], tile_points_[thread]);
+		});
+		counters_.draw_calls++;
+	}
+
+	void ObjectWindow::CollectCandidates(const SDL_Rect& area) { grid_.Query(area, candidates_); }
+
+	unsigned ObjectWindow::RecordShapeArrays(const SDL_Rect& area, unsigned layer) {
+		const int kinds = (int)ShapeKind::kCount;
+		size_t next[kinds] = {};
+		unsigned recorded = 0;
+		int right = area.x + area.w, bottom = area.y + area.h;
+		// Overlap with the element's PaintBounds
+		auto visible = [&](const ShapeArrays& shapes, size_t i) {
+			return shapes.x[i] < right && area.x <= shapes.x[i] + std::max(shapes.w[i], 0) &&
+				shapes.y[i] < bottom && area.y <= shapes.y[i] + std::max(shapes.h[i], 0) &&
+				shapes.layer[i] == layer && shapes.object[i] != nullptr;
+		};
+		for (;;) {
+			// The kind with the earliest next object goes next, for as long
+			// as its objects come before every other kind's next one
+			int kind = -1;
+			unsigned first = UINT_MAX, limit = UINT_MAX;
+			for (int k = 0; k < kinds; k++) {
+				if (next[k] == shapes_[k].Size())
+					continue;
+				unsigned order = shapes_[k].order[next[k]];
+				if (order < first) {
+					limit = first;
+					first = order;
+					kind = k;
+				}
+				else if (order < limit)
+					limit = order;
+			}
+			if (kind < 0)
+				return recorded;
+
+			const ShapeArrays& shapes = shapes_[kind];
+			size_t begin = next[kind], end = begin;
+			while (end < shapes.Size() && shapes.order[end] < limit)
+				end++;
+			next[kind] = end;
+
+			// Erased and unseen elements are skipped
+			switch ((ShapeKind)kind) {
+			case ShapeKind::kPoint:
+				for (size_t i = begin; i < end; i++) {
+					if (visible(shapes, i)) {
+						draw_list_.AddPoint(shapes.color[i], shapes.x[i], shapes.y[i]);
+						recorded++;
+					}
+				}
+				break;
+			case ShapeKind::kRectangle:
+				for (size_t i = begin; i < end; i++) {
+					if (visible(shapes, i)) {
+						draw_list_.AddRectangle(shapes.color[i],
+							SDL_Rect{ shapes.x[i], shapes.y[i], shapes.w[i], shapes.h[i] }, shapes.filled[i] != 0);
+						recorded++;
+					}
+				}
+				break;
+			case ShapeKind::kCircle:
+				for (size_t i = begin; i < end; i++) {
+					if (!visible(shapes, i))
+						continue;
+					int radius = shapes.w[i] / 2;
+					draw_list_.AddCircle(shapes.color[i], shapes.x[i] + radius,
+						shapes.y[i] + radius, radius, shapes.filled[i] != 0);
+					recorded++;
+				}
+				break;
+			default:
+				for (size_t i = begin; i < end; i++) {
+					if (visible(shapes, i)) {
+						shapes.object[i]->Paint();
+						recorded++;
+					}
+				}
+				break;
+			}
+		}
+	}
+
+	void ObjectWindow::AddDamage(const SDL_Rect& rect) {
+		// A pipelined Run paints every snapshot whole, and changes come from
+		// the simulation thread
+		if (!damage_tracking_ || pipeline_)
+			return;
+		invalid_ = true;
+		if (full_damage_)
+			return;
+
+		// Clip to the window; off-screen changes cost nothing
+		int left = std::max(rect.x, 0), top = std::max(rect.y, 0);
+		int right = std::min(rect.x + rect.w, width_);
+		int bottom = std::min(rect.y + rect.h, height_);
+		if (left >= right || top >= bottom)
+			return;
+		SDL_Rect region{ left, top, right - left, bottom - top };
+
+		// Absorb every region the new one overlaps; the union may now
+		// overlap regions it missed before, so rescan until it settles.
+		for (bool merged = true; merged;) {
+			merged = false;
+			for (size_t i = 0; i < damage_.size(); i++) {
+				if (RectsOverlap(damage_[i], region)) {
+					region = RectUnion(damage_[i], region);
+					damage_[i] = damage_.back();
+					damage_.pop_back();
+					merged = true;
+					break;
+				}
+			}
+		}
+		damage_.push_back(region);
+
+		long long area = 0;
+		for (const SDL_Rect& r : damage_)
+			area += (long long)r.w * r.h;
+		if (damage_.size() > kMaxDamageRects || area * 2 > (long long)width_ * height_)
+			full_damage_ = true;
+	}
+
+	void ObjectWindow::SetRenderBackend(RenderBackend backend) {
+		Window::SetRenderBackend(backend);
+		full_damage_ = true;
+	}
+
+	void ObjectWindow::SetDamageTracking(bool enabled) {
+		damage_tracking_ = enabled;
+		full_damage_ = true;
+		damage_.clear();
+		if (!enabled && canvas_) {
+			SDL_DestroyTexture(canvas_);
+			canvas_ = nullptr;
+		}
+	}
+
+	// Only objects of exactly a built-in type are painted from the arrays;
+	// a subclass may paint differently.
+	static ShapeKind KindOf(const GraphicalObject* obj) {
+		const std::type_info& type = typeid(*obj);
+		if (type == typeid(Point))
+			return ShapeKind::kPoint;
+		if (type == typeid(Rectangle))
+			return ShapeKind::kRectangle;
+		if (type == typeid(Circle))
+			return ShapeKind::kCircle;
+		return ShapeKind::kCustom;
+	}
+
+	void ObjectWindow::Add(GraphicalObject* obj) {
+		// A Text removed before a font change still holds the old layout
+		obj->FontChanged();
+		obj->object_index_ = objects_.size();
+		objects_.push_back(obj);
+		obj->in_window_ = true;
+		obj->order_ = next_order_++;
+		if (storage_ == ObjectStorage::kArrays) {
+			ShapeKind kind = KindOf(obj);
+			shapes_[(int)kind].Append(obj, kind);
+		}
+		grid_.Insert(obj, obj->rect_);
+		sweep_dirty_ = true;
+		layers_[obj->layer_].dirty = true;
+		AddDamage(ScreenBounds(obj->rect_));
+	}
+
+	void ObjectWindow::Remove(GraphicalObject * obj)
+	{
+		if (!obj->in_window_)
+			return;
+		if (storage_ == ObjectStorage::kArrays)
+			shapes_[obj->shape_].Erase(obj->slot_);
+		grid_.Remove(obj, obj->rect_);
+		obj->in_window_ = false;
+		obj->RemoveBody();
+		// Contacts still to be seen by the callback must not dangle
+		for (Contact& contact : contacts_) {
+			if (contact.body == obj)
+				contact.body = nullptr;
+			if (contact.other == obj)
+				contact.other = nullptr;
+		}
+		sweep_dirty_ = true;
+		layers_[obj->layer_].dirty = true;
+		AddDamage(ScreenBounds(obj->rect_));
+
+		// Leaves a hole so the objects after it keep their place in the
+		// draw order; holes are compacted away once they are half of it
+		objects_[obj->object_index_] = nullptr;
+		removed_objects_++;
+		if (removed_objects_ >= kMinCompaction && removed_objects_ * 2 > objects_.size())
+			CompactObjects();
+	}
+
+	void ObjectWindow::SetFont(const GlyphAtlas& font) {
+		Window::SetFont(font);
+		for (GraphicalObject* obj : objects_)
+			if (obj)
+				obj->FontChanged();
+	}
+
+	void ObjectWindow::CompactObjects()
+	{
+		size_t kept = 0;
+		for (GraphicalObject* o : objects_) {
+			if (!o)
+				continue;
+			o->object_index_ = kept;
+			objects_[kept++] = o;
+		}
+		objects_.resize(kept);
+		removed_objects_ = 0;
+	}
+
+	template <typename T, typename... Args>
+	Handle<T> ObjectWindow::Create(Args&&... args)
+	{
+		Handle<T> handle = pool_.Create<T>(this, std::forward<Args>(args)...);
+		Add(pool_.Get(handle));
+		return handle;
+	}
+
+	template <typename T>
+	T* ObjectWindow::Get(const Handle<T>& handle) const { return pool_.Get(handle); }
+
+	Handle<GraphicalObject> ObjectWindow::GetHandle(const GraphicalObject* obj) const
+	{
+		return pool_.GetHandle(obj);
+	}
+
+	bool ObjectWindow::Destroy(const Handle<GraphicalObject>& handle)
+	{
+		GraphicalObject* obj = pool_.Get(handle);
+		if (!obj)
+			return false;
+		Remove(obj);
+		return pool_.Destroy(handle);
+	}
+
+	void ObjectWindow::ObjectChanged(GraphicalObject* obj, const SDL_Rect& old_rect)
+	{
+		if (storage_ == ObjectStorage::kArrays)
+			shapes_[obj->shape_].Store(obj);
+		grid_.Move(obj, old_rect, obj->rect_);
+		layers_[obj->layer_].dirty = true;
+		AddDamage(ScreenBounds(old_rect));
+		AddDamage(ScreenBounds(obj->rect_));
+
+		// A setter that moved a body to another pixel drops its fractions
+		if (obj->body_ != GraphicalObject::kNoBody) {
+			float& x = bodies_.x[obj->body_];
+			float& y = bodies_.y[obj->body_];
+			if ((int)std::floor(x) != obj->rect_.x)
+				x = (float)obj->rect_.x;
+			if ((int)std::floor(y) != obj->rect_.y)
+				y = (float)obj->rect_.y;
+		}
+	}
+
+	// Overlap a body may start a step with and still be stopped by what
+	// it overlaps, left by rounding where the last step stopped it
+	static const float kContactSlop = 0.01f;
+
+	// Sweeps box a by (dx, dy) against box b, with inclusive edges like
+	// Collision.  On a hit, returns the fraction of the sweep at which
+	// they first touch and the face of b that was hit.
+	static bool SweepBoxes(const float a[4], float dx, float dy, const float b[4],
+		float& time, int& normal_x, int& normal_y) {
+		const float d[2] = { dx, dy };
+		float entry[2], exit[2], gap[2];
+		for (int axis = 0; axis < 2; axis++) {
+			float a_min = a[axis], a_max = a[axis] + a[axis + 2];
+			float b_min = b[axis], b_max = b[axis] + b[axis + 2];
+			if (d[axis] > 0.0f) {
+				gap[axis] = b_min - a_max;
+				entry[axis] = gap[axis] / d[axis];
+				exit[axis] = (b_max - a_min) / d[axis];
+			}
+			else if (d[axis] < 0.0f) {
+				gap[axis] = a_min - b_max;
+				entry[axis] = gap[axis] / -d[axis];
+				exit[axis] = (a_max - b_min) / -d[axis];
+			}
+			else if (a_max < b_min || b_max < a_min)
+				return false;
+			else {
+				gap[axis] = -INFINITY;
+				entry[axis] = -INFINITY;
+				exit[axis] = INFINITY;
+			}
+		}
+		int axis = entry[0] >= entry[1] ? 0 : 1;
+		float start = entry[axis], end = std::min(exit[0], exit[1]);
+		if (start > end || start > 1.0f || end <= 0.0f)
+			return false;
+		if (start < 0.0f) {
+			if (gap[axis] < -kContactSlop)
+				return false;
+			start = 0.0f;
+		}
+		time = start;
+		normal_x = axis == 0 ? (d[0] > 0.0f ? -1 : 1) : 0;
+		normal_y = axis == 1 ? (d[1] > 0.0f ? -1 : 1) : 0;
+		return true;
+	}
+
+	void ObjectWindow::Advance(double dt) {
+		StepBodies(dt);
+		Update(dt);
+	}
+
+	void ObjectWindow::StepBodies(double dt) {
+		size_t count = bodies_.Size();
+		if (count == 0)
+			return;
+		float step = (float)dt;
+		contacts_.clear();
+		body_stops_.clear();
+		if (contact_callback_) {
+			float reach = 0.0f;
+			for (size_t i = 0; i < count; i++)
+				reach = std::max(reach, std::max(std::fabs(bodies_.vx[i]), std::fabs(bodies_.vy[i])) * step);
+			for (size_t i = 0; i < count; i++)
+				if (bodies_.vx[i] != 0.0f || bodies_.vy[i] != 0.0f)
+					FindContacts(i, step, reach);
+		}
+
+		bodies_.Integrate(step);
+		for (const BodyStop& stop : body_stops_) {
+			bodies_.x[stop.body] = stop.x + bodies_.vx[stop.body] * step * stop.time;
+			bodies_.y[stop.body] = stop.y + bodies_.vy[stop.body] * step * stop.time;
+		}
+
+		// Only bodies that reached another pixel touch their objects
+		for (size_t i = 0; i < count; i++) {
+			GraphicalObject* obj = bodies_.object[i];
+			int x = (int)std::floor(bodies_.x[i]), y = (int)std::floor(bodies_.y[i]);
+			if (x == obj->rect_.x && y == obj->rect_.y)
+				continue;
+			SDL_Rect old_rect = obj->rect_;
+			obj->rect_.x = x;
+			obj->rect_.y = y;
+			obj->Changed(old_rect);
+		}
+
+		if (!contacts_.empty()) {
+			contact_callback_(Span<const Contact>(contacts_.data(), contacts_.size()));
+			contacts_.clear();
+		}
+	}
+
+	void ObjectWindow::FindContacts(size_t index, float dt, float reach) {
+		GraphicalObject* body = bodies_.object[index];
+		const float box[4] = { bodies_.x[index], bodies_.y[index],
+			(float)std::max(body->rect_.w, 0), (float)std::max(body->rect_.h, 0) };
+		float dx = bodies_.vx[index] * dt, dy = bodies_.vy[index] * dt;
+
+		// The path, widened by how far other bodies may come to meet it and
+		// by the fractions their pixel bounds in the index leave out
+		float margin = reach + 1.0f;
+		int left = (int)std::floor(std::min(box[0], box[0] + dx) - margin);
+		int top = (int)std::floor(std::min(box[1], box[1] + dy) - margin);
+		int right = (int)std::ceil(std::max(box[0], box[0] + dx) + box[2] + margin);
+		int bottom = (int)std::ceil(std::max(box[1], box[1] + dy) + box[3] + margin);
+		candidates_.clear();
+		CollectCandidates(SDL_Rect{ left, top, right - left, bottom - top });
+
+		size_t first = contacts_.size();
+		float earliest = 2.0f;
+		for (GraphicalObject* o : candidates_) {
+			if (o == body)
+				continue;
+			float other[4] = { (float)o->rect_.x, (float)o->rect_.y,
+				(float)std::max(o->rect_.w, 0), (float)std::max(o->rect_.h, 0) };
+			float relative_x = dx, relative_y = dy;
+			if (o->body_ != GraphicalObject::kNoBody) {
+				other[0] = bodies_.x[o->body_];
+				other[1] = bodies_.y[o->body_];
+				relative_x -= bodies_.vx[o->body_] * dt;
+				relative_y -= bodies_.vy[o->body_] * dt;
+			}
+			// Most candidates are nowhere near the path
+			if (box[0] + std::min(relative_x, 0.0f) > other[0] + other[2] ||
+				box[0] + box[2] + std::max(relative_x, 0.0f) < other[0] ||
+				box[1] + std::min(relative_y, 0.0f) > other[1] + other[3] ||
+				box[1] + box[3] + std::max(relative_y, 0.0f) < other[1])
+				continue;
+			float time;
+			int normal_x, normal_y;
+			if (!SweepBoxes(box, relative_x, relative_y, other, time, normal_x, normal_y) ||
+				time > earliest)
+				continue;
+			// Only the earliest contacts count; the body stops at them
+			if (time < earliest) {
+				contacts_.resize(first);
+				earliest = time;
+			}
+			contacts_.push_back(Contact{ body, o, time, normal_x, normal_y });
+		}
+		if (contacts_.size() == first)
+			return;
+		body_stops_.push_back(BodyStop{ (Uint32)index, earliest, box[0], box[1] });
+		// Candidates come in no particular order; contacts go in draw order
+		std::sort(contacts_.begin() + first, contacts_.end(), [](const Contact& a, const Contact& b) {
+			return a.other->order_ < b.other->order_;
+		});
+	}
+
+	void ObjectWindow::SetCamera(const Camera& camera) {
+		Camera clamped{ camera.x, camera.y, std::max(camera.zoom, kMinZoom) };
+		if (clamped.x == camera_.x && clamped.y == camera_.y && clamped.zoom == camera_.zoom)
+			return;
+		camera_ = clamped;
+		// Like Repaint; a pipelined Run paints every snapshot whole
+		if (!pipeline_) {
+			full_damage_ = true;
+			invalid_ = true;
+		}
+		// Caches are in screen space
+		for (Layer& layer : layers_)
+			layer.dirty = true;
+	}
+
+	const Camera& ObjectWindow::GetCamera() const { return camera_; }
+
+	SDL_Point ObjectWindow::ScreenToWorld(int x, int y) const {
+		return SDL_Point{ (int)std::floor(x / camera_.zoom + camera_.x),
+			(int)std::floor(y / camera_.zoom + camera_.y) };
+	}
+
+	SDL_Rect ObjectWindow::GetVisibleWorldRect() const { return WorldArea(SDL_Rect{ 0, 0, width_, height_ }); }
+
+	void ObjectWindow::SetContactCallback(const std::function<void(Span<const Contact>)>& callback) {
+		contact_callback_ = callback;
+	}
+
+	// Same inclusive edge test as GraphicalObject::Collision
+	static bool BoundsTouch(const SDL_Rect& a, const SDL_Rect& b) {
+		return a.x + a.w >= b.x && a.x <= b.x + b.w &&
+			a.y + a.h >= b.y && a.y <= b.y + b.h;
+	}
+
+	template <typename Predicate>
+	void ObjectWindow::FilterCandidates(Predicate keep)
+	{
+		candidates_.erase(std::remove_if(candidates_.begin(), candidates_.end(),
+			[&](GraphicalObject* o) { return !keep(o); }), candidates_.end());
+		std::sort(candidates_.begin(), candidates_.end(),
+			[](GraphicalObject* a, GraphicalObject* b) { return a->order_ < b->order_; });
+	}
+
+	GraphicalObject* ObjectWindow::GetFirstHit(int x, int y)
+	{
+		candidates_.clear();
+		grid_.Query(SDL_Rect{ x, y, 0, 0 }, candidates_);
+		GraphicalObject* first = nullptr;
+		for (GraphicalObject* o : candidates_)
+		{
+			if ((!first || o->order_ < first->order_) && o->Hit(x, y))
+				first = o;
+		}
+		return first;
+	}
+
+	void ObjectWindow::QueryPoint(int x, int y, vector<GraphicalObject*>& results)
+	{
+		candidates_.clear();
+		CollectCandidates(SDL_Rect{ x, y, 0, 0 });
+		FilterCandidates([&](GraphicalObject* o) { return o->Hit(x, y); });
+		results.assign(candidates_.begin(), candidates_.end());
+	}
+
+	void ObjectWindow::QueryRect(const SDL_Rect& rect, vector<GraphicalObject*>& results)
+	{
+		candidates_.clear();
+		CollectCandidates(rect);
+		FilterCandidates([&](GraphicalObject* o) { return BoundsTouch(o->rect_, rect); });
+		results.assign(candidates_.begin(), candidates_.end());
+	}
+
+	void ObjectWindow::ForEachCollision(GraphicalObject* obj,
+		const std::function<void(GraphicalObject*)>& callback)
+	{
+		vector<GraphicalObject*> hits;
+		QueryRect(obj->rect_, hits);
+		for (GraphicalObject* o : hits)
+		{
+			if (o != obj)
+				callback(o);
+		}
+	}
+
+	void ObjectWindow::ForEachCollisionPair(
+		const std::function<void(GraphicalObject*, GraphicalObject*)>& callback)
+	{
+		if (sweep_dirty_) {
+			sweep_.clear();
+			for (GraphicalObject* o : objects_)
+				if (o)
+					sweep_.push_back(o);
+			std::sort(sweep_.begin(), sweep_.end(),
+				[](GraphicalObject* a, GraphicalObject* b) { return a->rect_.x < b->rect_.x; });
+			sweep_dirty_ = false;
+		}
+		else {
+			// Insertion sort: objects move little between calls, so the list
+			// is nearly sorted already and this runs in close to linear time.
+			for (size_t i = 1; i < sweep_.size(); i++) {
+				GraphicalObject* o = sweep_[i];
+				size_t j = i;
+				for (; j > 0 && sweep_[j - 1]->rect_.x > o->rect_.x; j--)
+					sweep_[j] = sweep_[j - 1];
+				sweep_[j] = o;
+			}
+		}
+
+		vector<std::pair<GraphicalObject*, GraphicalObject*>> pairs;
+		for (size_t i = 0; i < sweep_.size(); i++) {
+			const SDL_Rect& a = sweep_[i]->rect_;
+			for (size_t j = i + 1; j < sweep_.size() && sweep_[j]->rect_.x <= a.x + a.w; j++) {
+				if (BoundsTouch(a, sweep_[j]->rect_))
+					pairs.push_back(std::make_pair(sweep_[i], sweep_[j]));
+			}
+		}
+		for (auto& pair : pairs)
+			callback(pair.first, pair.second);
+	}
+
+	void ObjectWindow::SetGridCellSize(int cell_size)
+	{
+		grid_ = SpatialGrid(cell_size);
+		for (GraphicalObject* o : objects_)
+			if (o)
+				grid_.Insert(o, o->rect_);
+	}
+
+	DrawList& ObjectWindow::GetDrawList() { return draw_list_; }
+
+	void ObjectWindow::SetDrawSorting(bool enabled) { draw_sorting_ = enabled; }
+
+	void ObjectWindow::SetObjectStorage(ObjectStorage storage)
+	{
+		if (storage == storage_)
+			return;
+		storage_ = storage;
+		for (ShapeArrays& shapes : shapes_)
+			shapes.Clear();
+		if (storage_ != ObjectStorage::kArrays)
+			return;
+		// objects_ is in draw order, which keeps every array in draw order
+		CompactObjects();
+		for (GraphicalObject* o : objects_) {
+			ShapeKind kind = KindOf(o);
+			shapes_[(int)kind].Append(o, kind);
+		}
+	}
+
+	ObjectStorage ObjectWindow::GetObjectStorage() const { return storage_; }
+
+	void ObjectWindow::SetTiledRendering(unsigned threads, int tile_size)
+	{
+		tile_size_ = tile_size > 0 ? tile_size : kDefaultTileSize;
+		if (threads == 0) {
+			workers_.reset();
+			return;
+		}
+		if (!workers_ || workers_->GetThreadCount() != threads)
+			workers_.reset(new WorkerPool(threads));
+		tile_spans_.resize(threads);
+		tile_points_.resize(threads);
+		SetRenderBackend(RenderBackend::kSoftware);
+		invalid_ = true;
+	}
+
+	unsigned ObjectWindow::GetRenderThreads() const
+	{
+		return workers_ ? workers_->GetThreadCount() : 0;
+	}
+
+	void ObjectWindow::SetPipelined(bool enabled)
+	{
+		pipelined_ = enabled;
+		if (enabled && !snapshots_)
+			snapshots_.reset(new TripleBuffer<SceneSnapshot>());
+		else if (!enabled)
+			snapshots_.reset();
+		full_damage_ = true;
+		invalid_ = true;
+	}
+
+	bool ObjectWindow::GetPipelined() const { return pipelined_; }
+
+	bool ObjectWindow::AddLayer(const string& name, int z, LayerMode mode)
+	{
+		for (const Layer& layer : layers_)
+			if (layer.name == name)
+				return false;
+		layers_.push_back(Layer{ name, z, mode, nullptr, true });
+		layer_order_.push_back((unsigned)layers_.size() - 1);
+		return SetLayerZ(name, z);
+	}
+
+	bool ObjectWindow::SetLayerZ(const string& name, int z)
+	{
+		for (Layer& layer : layers_) {
+			if (layer.name != name)
+				continue;
+			layer.z = z;
+			// Layers of equal z keep the order they were added in
+			std::sort(layer_order_.begin(), layer_order_.end(), [&](unsigned a, unsigned b) {
+				return layers_[a].z != layers_[b].z ? layers_[a].z < layers_[b].z : a < b;
+			});
+			if (!pipeline_) {
+				full_damage_ = true;
+				invalid_ = true;
+			}
+			return true;
+		}
+		return false;
+	}
+
+	bool ObjectWindow::SetLayer(GraphicalObject* obj, const string& name)
+	{
+		for (unsigned index = 0; index < layers_.size(); index++) {
+			if (layers_[index].name != name)
+				continue;
+			if (obj->layer_ != index) {
+				layers_[obj->layer_].dirty = true;
+				obj->layer_ = index;
+				obj->Changed(obj->rect_);
+			}
+			return true;
+		}
+		return false;
+	}
+
+	const string& ObjectWindow::GetLayer(const GraphicalObject* obj) const
+	{
+		return layers_[obj->layer_].name;
 	}
 
 	//------------------------------------------------------//
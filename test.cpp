@@ -4,48 +4,47 @@ using namespace sgl2;
 
 class MyObjectWindow : public ObjectWindow {
 private:
-	Rectangle* button_;
+	Handle<Rectangle> button_;
 	Circle* ball_;
 	Rectangle* paddle_;
-	vector<Rectangle*> bricks_;
-
-	int button_id_;
+	int bricks_left_;
 
 	bool game_running_;
 
-	float x_;
-	float y_;
-	float v_x_;
-	float v_y_;
-
 public:
 	MyObjectWindow(const string& title, int width, int height,
-		const Color& background)
-		: ObjectWindow(title, width, height, background), button_(nullptr), ball_(nullptr), paddle_(nullptr), game_running_(false), x_(390.0f), y_(290.0f), v_x_(-0.05f), v_y_(0.05f) {
-		button_ = new Rectangle(this, Color(0, 255, 0), 0, 0, 100, 30, true);
-		ball_ = new Circle(this, Color(255, 100, 0), 390, 290, 9, true);
-		paddle_ = new Rectangle(this, Color(255, 255, 255), 750, 500, 150, 20, true);
-
-		button_id_ = button_->id_;
-
-		Add(button_);
-		Add(ball_);
-		Add(paddle_);
-
-		bricks_ = vector<Rectangle*>();
+		const Color& background, WindowMode mode = WindowMode::kShown)
+		: ObjectWindow(title, width, height, background, mode), ball_(nullptr), paddle_(nullptr), bricks_left_(0), game_running_(false) {
+		SetDamageTracking(true);
+
+		// Ball speeds are in pixels per second, stepped at a fixed rate
+		// so the game plays the same on every machine
+		SetFixedTimestep(1.0 / 240.0);
+		SetFrameRate(60);
+
+		// The window owns everything it creates and frees it on exit
+		button_ = Create<Rectangle>(Color(0, 255, 0), 0, 0, 100, 30, true);
+		ball_ = Get(Create<Circle>(Color(255, 100, 0), 390, 290, 9, true));
+		paddle_ = Get(Create<Rectangle>(Color(255, 255, 255), 750, 500, 150, 20, true));
+
+		// The bricks only change when one is hit, so they are painted once
+		// into a cached layer underneath everything else
+		AddLayer("bricks", -1, LayerMode::kStatic);
+
+		// The window moves the ball and stops it on whatever it runs into
+		SetContactCallback([this](Span<const Contact> contacts) { BallContacts(contacts); });
+	}
 
+	void StartGame() {
 		for (int y = 0; y < 8; ++y) {
 			for (int x = 0; x < (10 - (y % 2 == 0 ? 2 : 0)); ++x) {
-				Rectangle* brick = new Rectangle(this, Color(40 * (y + 1), 50 * (x + 1), 0), 80 * (x + (y % 2 == 0 ? 1 : 0)), 20 * y, 80, 20, true);
-				bricks_.push_back(brick);
+				Handle<Rectangle> brick = Create<Rectangle>(Color(40 * (y + 1), 50 * (x + 1), 0), 80 * (x + (y % 2 == 0 ? 1 : 0)), 20 * y, 80, 20, true);
+				SetLayer(Get(brick), "bricks");
+				bricks_left_++;
 			}
 		}
-	}
-
-	void StartGame() {
-		for (auto b : bricks_)
-			Add(b);
 		game_running_ = true;
+		ball_->SetVelocity(-240.0f, 240.0f);
 	}
 
 	void MouseMoved(const MouseMotionEvent& event) override {
@@ -54,8 +53,8 @@ public:
 
 	void MousePressed(const MouseButtonEvent& event) override {
 		GraphicalObject* obj = GetFirstHit(event.x, event.y);
-		if (obj && obj->id_ == button_id_) {
-			Remove(obj);
+		if (obj && GetHandle(obj) == button_) {
+			Destroy(button_);
 			StartGame();
 		}
 
@@ -66,20 +65,35 @@ public:
 			Quit();
 	}
 
-	void Update() override {
-		if (game_running_) {
-			ball_->SetPosX(int(x_ += v_x_));
-			ball_->SetPosY(int(y_ += v_y_));
-			if (ball_->Collision(paddle_)) {
-				v_y_ *= -1.0;
-				v_x_ += fmodf((float)rand() / RAND_MAX, 0.04f) - 0.02f;
-			}
+	float Jitter() {
+		return ((float)rand() / RAND_MAX - 0.5f) * 192.0f;
+	}
+
+	// Bounces the ball off the faces it hit, at most once per axis
+	void BallContacts(Span<const Contact> contacts) {
+		float v_x = ball_->GetVelocityX(), v_y = ball_->GetVelocityY();
+		bool flip_x = false, flip_y = false;
+		for (const Contact& contact : contacts) {
+			if (contact.body != ball_ || !contact.other)
+				continue;
+			flip_x = flip_x || contact.normal_x * v_x < 0.0f;
+			flip_y = flip_y || contact.normal_y * v_y < 0.0f;
+			if (contact.other == paddle_)
+				continue;
+			Destroy(GetHandle(contact.other));
+			bricks_left_--;
+		}
+		ball_->SetVelocity((flip_x ? -v_x : v_x) + Jitter(), flip_y ? -v_y : v_y);
+	}
 
-			if (ball_->GetPosY() <= 0)
-				v_y_ *= -1.0;
+	void Update(double dt) override {
+		if (game_running_) {
+			float v_x = ball_->GetVelocityX(), v_y = ball_->GetVelocityY();
+			if (ball_->GetPosY() <= 0 && v_y < 0.0f)
+				ball_->SetVelocity(v_x, -v_y);
 
-			if (ball_->GetPosX() <= 0 || ball_->GetPosX() >= 789)
-				v_x_ *= -1.0;
+			if ((ball_->GetPosX() <= 0 && v_x < 0.0f) || (ball_->GetPosX() >= 789 && v_x > 0.0f))
+				ball_->SetVelocity(-v_x, v_y);
 
 			if (ball_->GetPosY() > 600) {
 				SetBackgroundColor(Color(255, 0, 0));
@@ -87,20 +101,10 @@ public:
 				game_running_ = false;
 			}
 
-			for (auto brick : bricks_) {
-				if (ball_->Collision(brick)) {
-					v_x_ *= (x_ + ball_->GetWidth() <= brick->GetPosX() || x_ >= brick->GetPosX() + brick->GetWidth() ? -1.0f : 1.0f);
-					v_y_ *= (y_ + ball_->GetHeight() <= brick->GetPosY() || y_ >= brick->GetPosY() + brick->GetHeight() ? -1.0f : 1.0f);
-					v_x_ += fmodf((float)rand() / RAND_MAX, 0.04f) - 0.02f;
-					Remove(brick);
-					bricks_.erase(std::remove(bricks_.begin(), bricks_.end(), brick), bricks_.end());
-					break;
-				}
-			}
-
-			if (bricks_.size() == 0) {
+			if (bricks_left_ == 0) {
 				SetBackgroundColor(Color(0, 255, 0));
 				game_running_ = false;
+				ball_->SetVelocity(0.0f, 0.0f);
 			}
 
 			Repaint();
@@ -108,9 +112,21 @@ public:
 	}
 };
 
-int main() {
-	MyObjectWindow window = MyObjectWindow("test", 800, 600, Color(0, 0, 0));
+// test --record <log> plays as usual and logs the input; test --replay
+// <log> plays a log back offscreen as fast as possible, writing per-frame
+// timings to frames.csv
+int main(int argc, char* argv[]) {
+	string mode = argc == 3 ? argv[1] : "";
+	if (mode == "--replay") {
+		MyObjectWindow window("test", 800, 600, Color(0, 0, 0), WindowMode::kOffscreen);
+		window.GetProfiler().SetDumpFile("frames.csv");
+		return window.ReplayInput(argv[2]) ? 0 : 1;
+	}
+
+	MyObjectWindow window("test", 800, 600, Color(0, 0, 0));
 	srand(SDL_GetTicks());
+	if (mode == "--record" && !window.StartInputRecording(argv[2]))
+		return 1;
 
 	window.Run();
 
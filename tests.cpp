@@ -0,0 +1,63 @@
+#include "sgl2.hpp"
+#include <cstdio>
+
+using namespace sgl2;
+
+// Regression tests for the SGL2 object windows.  Every case runs on an
+// offscreen window, so no display or GPU is needed.  Prints each failed
+// check and exits with the number of failures:
+//
+//     tests
+
+static const int kWidth = 64;
+static const int kHeight = 48;
+
+static int failures;
+
+static void Check(bool passed, const char* test, const char* what) {
+	if (passed)
+		return;
+	fprintf(stderr, "%s: %s\n", test, what);
+	failures++;
+}
+
+class TestObjectWindow : public ObjectWindow {
+public:
+	TestObjectWindow()
+		: ObjectWindow("tests", kWidth, kHeight, Color(0, 0, 0), WindowMode::kOffscreen) {}
+
+	Uint32 PixelAt(int x, int y) {
+		vector<Uint32> pixels;
+		if (!ReadPixels(pixels))
+			return 0;
+		return pixels[(size_t)y * kWidth + x];
+	}
+};
+
+// SetPipelined only changes how Run paints, so Step and RenderFrame keep
+// repainting the damage of objects moved between frames.
+static void TestPipelinedDamage() {
+	const RenderBackend backends[] = { RenderBackend::kRenderer, RenderBackend::kSoftware };
+	for (RenderBackend backend : backends) {
+		TestObjectWindow window;
+		window.SetRenderBackend(backend);
+		window.SetDamageTracking(true);
+		window.SetPipelined(true);
+		Rectangle* square = window.Get(window.Create<Rectangle>(Color(255, 0, 0), 4, 4, 8, 8, true));
+		window.RenderFrame();
+		Check(window.PixelAt(8, 8) == 0xFFFF0000, "PipelinedDamage", "first frame misses the square");
+
+		square->SetPosX(40);
+		window.RenderFrame();
+		Check(window.PixelAt(44, 8) == 0xFFFF0000, "PipelinedDamage", "moved square not painted");
+		Check(window.PixelAt(8, 8) == 0xFF000000, "PipelinedDamage", "old position not cleared");
+	}
+}
+
+int main() {
+	TestPipelinedDamage();
+
+	if (failures == 0)
+		printf("all tests passed\n");
+	return failures;
+}